@@ -0,0 +1,682 @@
+/*
+ * bench.c - a cycle-counter benchmark harness shared by the labs
+ *
+ * The sampling follows the K-best scheme of the CS:APP fcyc package: the
+ * benchmark is run until the kbest smallest samples are within epsilon of
+ * each other, and the smallest is taken as its running time. Interrupts
+ * and other processes only ever make a sample slower, so the statistics
+ * are computed after dropping the samples that are far above the median.
+ *
+ * The hardware events are counted by one perf_event_open group, started
+ * and stopped around each sample, so that they are either all counted
+ * over the same instructions or, if the PMU cannot schedule the group,
+ * not at all. Only user-space events of the calling thread are counted,
+ * which an unprivileged process is allowed to do.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "bench.h"
+
+/* Default values */
+#define WARMUP 1             /* untimed runs before sampling */
+#define K 3                  /* Value of K in K-best scheme */
+#define EPSILON 0.01         /* K samples should be EPSILON of each other */
+#define MAXSAMPLES 20        /* Give up after MAXSAMPLES */
+#define OUTLIER 3.0          /* reject samples OUTLIER MADs above the median */
+#define FLUSH_BYTES (8<<20)  /* more than the last-level cache */
+#define FLUSH_LINE 64        /* cache line size in bytes */
+
+#define MAD_SIGMA 1.4826     /* MAD to standard deviation, for normal data */
+#define MHZ_NSECS 50000000   /* how long bench_mhz counts cycles for */
+
+/* Student's t at 97.5% for 1..30 degrees of freedom; 1.96 beyond */
+static const double t975[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+#define T975_DF (int)(sizeof(t975) / sizeof(t975[0]))
+
+static char *flush_buf = NULL;   /* written to evict the caches */
+static int flush_size = 0;
+static volatile char sink;
+static int pinned_cpu = -1;
+static int reported = 0;         /* records printed since bench_header */
+
+/* The hardware events, in BENCH_INSTRUCTIONS ... order */
+static const char *counter_names[BENCH_NCOUNTERS] = {
+	"instructions", "cache_misses", "branch_misses", "dtlb_misses"
+};
+static const char *counter_titles[BENCH_NCOUNTERS] = {
+	"Instructions", "Cache Misses", "Branch Misses", "dTLB Misses"
+};
+static int counters_tried = 0;   /* has open_counters run? */
+static int group_fd = -1;        /* leader of the event group, or -1 */
+static int group_slot[BENCH_NCOUNTERS];  /* place in the group, or -1 */
+static int group_size = 0;
+
+/*
+ * bench_error - Report a bad option and exit
+ */
+static void bench_error(const char *msg, const char *arg)
+{
+	fprintf(stderr, "ERROR: %s: %s\n", msg, arg);
+	exit(1);
+}
+
+/*
+ * sample_limit - the most samples a benchmark under config may take
+ */
+static int sample_limit(const bench_config_t *config)
+{
+	if (config->kbest == 0 || config->maxsamples < config->minsamples)
+		return config->minsamples;
+	return config->maxsamples;
+}
+
+/*
+ * flush_caches - Evict the benchmark's data from the caches by writing
+ *     one byte of every line of a buffer larger than they are
+ */
+static void flush_caches(int bytes)
+{
+	char x = sink;
+	int i;
+
+	if (bytes != flush_size) {
+		free(flush_buf);
+		if ((flush_buf = calloc(1, bytes)) == NULL) {
+			fprintf(stderr, "ERROR: could not allocate %d bytes to flush "
+					"the caches\n", bytes);
+			exit(1);
+		}
+		flush_size = bytes;
+	}
+	for (i = 0; i < bytes; i += FLUSH_LINE)
+		x += flush_buf[i]++;
+	sink = x;
+}
+
+#ifdef __linux__
+/*
+ * open_counters - Open what events we can as one disabled group; an
+ *     event the kernel refuses is left out with a warning
+ */
+static void open_counters(void)
+{
+	static const uint32_t types[BENCH_NCOUNTERS] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+		PERF_TYPE_HW_CACHE
+	};
+	static const uint64_t configs[BENCH_NCOUNTERS] = {
+		PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+	};
+	struct perf_event_attr attr;
+	int i, fd;
+
+	counters_tried = 1;
+	for (i = 0; i < BENCH_NCOUNTERS; i++) {
+		group_slot[i] = -1;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[i];
+		attr.config = configs[i];
+		attr.disabled = (group_fd < 0);  /* the leader starts the group */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+		if (fd < 0) {
+			fprintf(stderr, "Warning: cannot count %s: %s\n",
+					counter_names[i], strerror(errno));
+			continue;
+		}
+		if (group_fd < 0)
+			group_fd = fd;
+		group_slot[i] = group_size++;
+	}
+}
+
+/*
+ * start_counters - Zero the event group and start it
+ */
+static void start_counters(void)
+{
+	if (group_fd >= 0) {
+		ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+/*
+ * stop_counters - Stop the event group and read it into counts, with -1
+ *     for the events that were not counted
+ */
+static void stop_counters(double *counts)
+{
+	/* nr, time running, then one value per event in the group */
+	uint64_t buf[2 + BENCH_NCOUNTERS];
+	int i, ok = 0;
+
+	if (group_fd >= 0) {
+		ioctl(group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		ok = read(group_fd, buf, sizeof(buf)) > 0 && buf[1] > 0;
+	}
+	for (i = 0; i < BENCH_NCOUNTERS; i++)
+		counts[i] = (ok && group_slot[i] >= 0)
+			? (double)buf[2 + group_slot[i]] : -1;
+}
+#else
+static void open_counters(void)
+{
+	counters_tried = 1;
+	fprintf(stderr, "Warning: hardware counters need Linux's "
+			"perf_event_open; reporting cycles only\n");
+}
+
+static void start_counters(void)
+{
+}
+
+static void stop_counters(double *counts)
+{
+	int i;
+
+	for (i = 0; i < BENCH_NCOUNTERS; i++)
+		counts[i] = -1;
+}
+#endif
+
+/*
+ * add_sample - Record one run; warmup runs are dropped
+ */
+static void add_sample(bench_t *b, const bench_sample_t *sample)
+{
+	int pos;
+
+	if (b->nwarm < b->config->warmup) {
+		b->nwarm++;
+		return;
+	}
+	if (b->nsamples == sample_limit(b->config))
+		return;
+
+	/* insertion sort */
+	for (pos = b->nsamples++;
+			pos > 0 && b->samples[pos-1].cycles > sample->cycles; pos--)
+		b->samples[pos] = b->samples[pos-1];
+	b->samples[pos] = *sample;
+}
+
+/*
+ * compare_doubles - qsort order for the samples
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*************************************************************
+ * Configuration
+ ************************************************************/
+
+/*
+ * bench_init - Fill in the default configuration: K-best sampling as
+ *     fcyc did it, one warmup run, outliers rejected, no flushing or
+ *     pinning, and the program's own output
+ */
+void bench_init(bench_config_t *config)
+{
+	config->warmup = WARMUP;
+	config->kbest = K;
+	config->epsilon = EPSILON;
+	config->minsamples = K;
+	config->maxsamples = MAXSAMPLES;
+	config->outlier = OUTLIER;
+	config->flush = 0;
+	config->flush_bytes = FLUSH_BYTES;
+	config->cpu = -1;
+	config->format = BENCH_TEXT;
+	config->counters = 0;
+}
+
+/*
+ * bench_option - Apply one of the BENCH_OPTS command line options.
+ *     Returns 1 if ch was one of them, 0 if it is the program's own.
+ */
+int bench_option(bench_config_t *config, int ch, const char *arg)
+{
+	switch (ch) {
+		case 'w':
+			if ((config->warmup = atoi(arg)) < 0)
+				bench_error("the warmup runs must not be negative", arg);
+			return 1;
+		case 'x':
+			config->flush = 1;
+			return 1;
+		case 'P':
+			if ((config->cpu = atoi(arg)) < 0)
+				bench_error("the CPU must not be negative", arg);
+			return 1;
+		case 'O':
+			if ((config->outlier = atof(arg)) < 0)
+				bench_error("the outlier cutoff must not be negative", arg);
+			return 1;
+		case 'E':
+			config->counters = 1;
+			return 1;
+		case 'o':
+			if (strcmp(arg, "csv") == 0)
+				config->format = BENCH_CSV;
+			else if (strcmp(arg, "json") == 0)
+				config->format = BENCH_JSON;
+			else if (strcmp(arg, "text") == 0)
+				config->format = BENCH_TEXT;
+			else
+				bench_error("unknown output format", arg);
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/*
+ * bench_usage - Describe the BENCH_OPTS options
+ */
+void bench_usage(FILE *fp)
+{
+	fprintf(fp, "\t-w <n>     Untimed warmup runs before sampling (default %d).\n",
+			WARMUP);
+	fprintf(fp, "\t-x         Flush the caches before every sample.\n");
+	fprintf(fp, "\t-P <cpu>   Pin the benchmark to CPU <cpu>.\n");
+	fprintf(fp, "\t-O <k>     Reject samples k MADs above the median (default %.0f, 0 keeps all).\n",
+			OUTLIER);
+	fprintf(fp, "\t-o <fmt>   Report the timings as text, csv or json.\n");
+	fprintf(fp, "\t-E         Count instructions and cache, branch and dTLB misses too.\n");
+}
+
+/*
+ * bench_pin - Run the process on the given CPU only, so the benchmark is
+ *     not migrated between samples. Returns 0, or -1 if that failed.
+ */
+int bench_pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		fprintf(stderr, "Warning: could not pin the benchmark to CPU %d\n",
+				cpu);
+		return -1;
+	}
+	pinned_cpu = cpu;
+	return 0;
+}
+
+/*
+ * bench_mhz - The rate of the cycle counter in MHz, measured against the
+ *     monotonic clock the first time it is asked for
+ */
+double bench_mhz(void)
+{
+	static double mhz = 0;
+	struct timespec t0, t1;
+	uint64_t c0, c1;
+	double ns;
+
+	if (mhz == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		c0 = bench_cycles();
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		} while (ns < MHZ_NSECS);
+		c1 = bench_cycles();
+		mhz = (c1 - c0) / (ns / 1e3);
+	}
+	return mhz;
+}
+
+/*************************************************************
+ * Sampling
+ ************************************************************/
+
+/*
+ * bench_start - Begin a benchmark, pinning the process and opening the
+ *     event counters first if asked
+ */
+void bench_start(bench_t *b, const bench_config_t *config)
+{
+	if (config->cpu >= 0 && config->cpu != pinned_cpu)
+		bench_pin(config->cpu);
+	if (config->counters && !counters_tried)
+		open_counters();
+	b->config = config;
+	b->nsamples = 0;
+	b->nwarm = 0;
+	if ((b->samples = calloc(sample_limit(config), sizeof(bench_sample_t))) == NULL) {
+		fprintf(stderr, "ERROR: could not allocate the benchmark samples\n");
+		exit(1);
+	}
+}
+
+/*
+ * bench_more - Is another run wanted? Flushes the caches before it if
+ *     the configuration says so.
+ */
+int bench_more(bench_t *b)
+{
+	const bench_config_t *config = b->config;
+	int k = config->kbest;
+
+	if (b->nwarm == config->warmup) {
+		if (b->nsamples >= sample_limit(config))
+			return 0;
+		if (b->nsamples >= config->minsamples && k > 0 && b->nsamples >= k &&
+				(1 + config->epsilon) * b->samples[0].cycles >= b->samples[k-1].cycles)
+			return 0;
+	}
+	if (config->flush)
+		flush_caches(config->flush_bytes);
+	return 1;
+}
+
+/*
+ * bench_begin - Start measuring a run
+ */
+void bench_begin(bench_t *b)
+{
+	if (b->config->counters)
+		start_counters();
+	b->start = bench_cycles();
+}
+
+/*
+ * bench_end - Finish measuring the run started by bench_begin
+ */
+void bench_end(bench_t *b)
+{
+	bench_sample_t sample;
+	int i;
+
+	sample.cycles = bench_cycles() - b->start;
+	if (b->config->counters)
+		stop_counters(sample.counters);
+	else
+		for (i = 0; i < BENCH_NCOUNTERS; i++)
+			sample.counters[i] = -1;
+	add_sample(b, &sample);
+}
+
+/*
+ * bench_add - Record the cycles of a run the caller measured itself;
+ *     no events are counted for it
+ */
+void bench_add(bench_t *b, double cycles)
+{
+	bench_sample_t sample;
+	int i;
+
+	sample.cycles = cycles;
+	for (i = 0; i < BENCH_NCOUNTERS; i++)
+		sample.counters[i] = -1;
+	add_sample(b, &sample);
+}
+
+/*
+ * bench_finish - Reject the outliers among the samples and summarize
+ *     the rest
+ */
+void bench_finish(bench_t *b, bench_result_t *result)
+{
+	const bench_config_t *config = b->config;
+	double *dev, limit, sum = 0, sq = 0;
+	int i, c, n = b->nsamples;
+
+	memset(result, 0, sizeof(*result));
+	result->samples = n;
+	if (n == 0) {
+		for (c = 0; c < BENCH_NCOUNTERS; c++)
+			result->counters[c] = -1;
+		free(b->samples);
+		return;
+	}
+	result->best = b->samples[0].cycles;
+	result->median = (n % 2) ? b->samples[n/2].cycles
+		: (b->samples[n/2-1].cycles + b->samples[n/2].cycles) / 2;
+
+	/* samples slower than median + outlier * MAD are interference */
+	result->kept = n;
+	if (config->outlier > 0 && (dev = malloc(n * sizeof(double))) != NULL) {
+		for (i = 0; i < n; i++)
+			dev[i] = fabs(b->samples[i].cycles - result->median);
+		qsort(dev, n, sizeof(double), compare_doubles);
+		limit = result->median + config->outlier * MAD_SIGMA *
+			((n % 2) ? dev[n/2] : (dev[n/2-1] + dev[n/2]) / 2);
+		if (limit < result->median * (1 + config->epsilon))
+			limit = result->median * (1 + config->epsilon);
+		while (result->kept > 1 && b->samples[result->kept-1].cycles > limit)
+			result->kept--;
+		free(dev);
+	}
+
+	for (i = 0; i < result->kept; i++)
+		sum += b->samples[i].cycles;
+	result->mean = sum / result->kept;
+	if (result->kept > 1) {
+		for (i = 0; i < result->kept; i++)
+			sq += (b->samples[i].cycles - result->mean) *
+				(b->samples[i].cycles - result->mean);
+		result->stddev = sqrt(sq / (result->kept - 1));
+		result->ci95 = ((result->kept - 1 <= T975_DF)
+				? t975[result->kept - 2] : 1.96)
+			* result->stddev / sqrt(result->kept);
+	}
+
+	/* an event counts only if it was counted in every kept sample */
+	for (c = 0; c < BENCH_NCOUNTERS; c++) {
+		for (sum = 0, i = 0; i < result->kept; i++) {
+			if (b->samples[i].counters[c] < 0)
+				break;
+			sum += b->samples[i].counters[c];
+		}
+		result->counters[c] = (i == result->kept) ? sum / result->kept : -1;
+	}
+	free(b->samples);
+	b->samples = NULL;
+}
+
+/*
+ * bench_run - Time f(argp) as config says, fill in result if it is not
+ *     NULL, and return the K-best estimate of its cycles
+ */
+double bench_run(const bench_config_t *config, bench_funct f, void *argp,
+		bench_result_t *result)
+{
+	bench_result_t mine;
+	bench_t b;
+
+	if (result == NULL)
+		result = &mine;
+	bench_start(&b, config);
+	while (bench_more(&b)) {
+		bench_begin(&b);
+		f(argp);
+		bench_end(&b);
+	}
+	bench_finish(&b, result);
+	return result->best;
+}
+
+/*************************************************************
+ * Reporting
+ ************************************************************/
+
+/*
+ * print_name - Print a benchmark name as a quoted CSV field or JSON
+ *     string, escaping its quotes
+ */
+static void print_name(FILE *fp, const char *name, int format)
+{
+	fputc('"', fp);
+	for (; *name; name++) {
+		if (*name == '"')
+			fputs((format == BENCH_CSV) ? "\"\"" : "\\\"", fp);
+		else if (*name == '\\' && format == BENCH_JSON)
+			fputs("\\\\", fp);
+		else
+			fputc(*name, fp);
+	}
+	fputc('"', fp);
+}
+
+/*
+ * counter_per_n - Event c of result per unit of n, or -1 if not counted
+ */
+static double counter_per_n(const bench_result_t *result, int c, long n)
+{
+	if (result->counters[c] < 0)
+		return -1;
+	return (n > 0) ? result->counters[c] / n : result->counters[c];
+}
+
+/*
+ * bench_header - Start a CSV or JSON report
+ */
+void bench_header(FILE *fp, const bench_config_t *config)
+{
+	int c;
+
+	reported = 0;
+	if (config->format == BENCH_CSV) {
+		fprintf(fp, "name,n,samples,kept,best,median,mean,stddev,ci95,"
+				"cycles_per_n,mhz");
+		for (c = 0; config->counters && c < BENCH_NCOUNTERS; c++)
+			fprintf(fp, ",%s_per_n", counter_names[c]);
+		fprintf(fp, "\n");
+	}
+	else if (config->format == BENCH_JSON)
+		fprintf(fp, "[\n");
+}
+
+/*
+ * bench_report - Print the result of one benchmark of size n (elements,
+ *     requests, ...) in the configured format, with the events per unit
+ *     of n if they were counted
+ */
+void bench_report(FILE *fp, const bench_config_t *config, const char *name,
+		long n, const bench_result_t *result)
+{
+	double per_n = (n > 0) ? result->mean / n : 0;
+	double count;
+	int c;
+
+	switch (config->format) {
+		case BENCH_CSV:
+			print_name(fp, name, config->format);
+			fprintf(fp, ",%ld,%d,%d,%.0f,%.0f,%.1f,%.1f,%.1f,%.3f,%.1f",
+					n, result->samples, result->kept, result->best,
+					result->median, result->mean, result->stddev,
+					result->ci95, per_n, bench_mhz());
+			for (c = 0; config->counters && c < BENCH_NCOUNTERS; c++) {
+				if ((count = counter_per_n(result, c, n)) < 0)
+					fprintf(fp, ",");
+				else
+					fprintf(fp, ",%.3f", count);
+			}
+			fprintf(fp, "\n");
+			break;
+		case BENCH_JSON:
+			fprintf(fp, "%s  {\"name\": ", reported ? ",\n" : "");
+			print_name(fp, name, config->format);
+			fprintf(fp, ", \"n\": %ld, \"samples\": %d, \"kept\": %d, "
+					"\"best\": %.0f, \"median\": %.0f, \"mean\": %.1f, "
+					"\"stddev\": %.1f, \"ci95\": %.1f, "
+					"\"cycles_per_n\": %.3f, \"mhz\": %.1f",
+					n, result->samples, result->kept, result->best,
+					result->median, result->mean, result->stddev,
+					result->ci95, per_n, bench_mhz());
+			for (c = 0; config->counters && c < BENCH_NCOUNTERS; c++) {
+				if ((count = counter_per_n(result, c, n)) < 0)
+					fprintf(fp, ", \"%s_per_n\": null", counter_names[c]);
+				else
+					fprintf(fp, ", \"%s_per_n\": %.3f", counter_names[c],
+							count);
+			}
+			fprintf(fp, "}");
+			break;
+		default:
+			fprintf(fp, "%s: n %ld, best %.0f, mean %.0f +- %.0f cycles "
+					"(%d of %d samples)\n", name, n, result->best,
+					result->mean, result->ci95, result->kept,
+					result->samples);
+			if (!config->counters)
+				break;
+			fprintf(fp, "    per n: %.2f cycles", per_n);
+			for (c = 0; c < BENCH_NCOUNTERS; c++) {
+				if ((count = counter_per_n(result, c, n)) < 0)
+					fprintf(fp, ", %s -", counter_names[c]);
+				else
+					fprintf(fp, ", %s %.3f", counter_names[c], count);
+			}
+			fprintf(fp, "\n");
+	}
+	reported++;
+}
+
+/*
+ * bench_footer - Finish a CSV or JSON report
+ */
+void bench_footer(FILE *fp, const bench_config_t *config)
+{
+	if (config->format == BENCH_JSON)
+		fprintf(fp, "%s]\n", reported ? "\n" : "");
+}
+
+/*
+ * bench_counter_header - The titles of the event columns that
+ *     bench_counter_columns adds to a program's own tab-separated table
+ */
+void bench_counter_header(FILE *fp, const bench_config_t *config)
+{
+	int c;
+
+	for (c = 0; config->counters && c < BENCH_NCOUNTERS; c++)
+		fprintf(fp, "\t%s", counter_titles[c]);
+}
+
+/*
+ * bench_counter_columns - The events of result per unit of n as extra
+ *     tab-separated columns, "-" for those not counted
+ */
+void bench_counter_columns(FILE *fp, const bench_config_t *config, long n,
+		const bench_result_t *result)
+{
+	double count;
+	int c;
+
+	for (c = 0; config->counters && c < BENCH_NCOUNTERS; c++) {
+		if ((count = counter_per_n(result, c, n)) < 0)
+			fprintf(fp, "\t-");
+		else
+			fprintf(fp, "\t%.3f", count);
+	}
+}
@@ -0,0 +1,135 @@
+/*
+ * bench.h - a cycle-counter benchmark harness shared by the labs
+ *
+ * It grew out of the CS:APP fcyc package that lab03's mdriver used: a
+ * benchmark is run until the K smallest of its samples agree, but it also
+ * takes untimed warmup runs, rejects outliers, reports a confidence
+ * interval, can pin itself to a CPU and flush the caches before every
+ * sample, and prints its results as CSV or JSON so that numbers from
+ * mdriver, listperf and the sort programs can be put side by side.
+ *
+ * A function can be timed whole with bench_run, or a program can time
+ * its own region of interest:
+ *
+ *	bench_t b;
+ *	bench_start(&b, &config);
+ *	while (bench_more(&b)) {
+ *		setup();
+ *		bench_begin(&b);
+ *		work();
+ *		bench_end(&b);
+ *	}
+ *	bench_finish(&b, &result);
+ *
+ * With config.counters set, the region is also measured with hardware
+ * event counters through perf_event_open. Events the kernel or the
+ * machine cannot count are reported as unavailable, and the cycles are
+ * measured as usual.
+ */
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Output formats */
+#define BENCH_TEXT 0   /* the program's own table */
+#define BENCH_CSV  1
+#define BENCH_JSON 2
+
+/* getopt letters that bench_option understands */
+#define BENCH_OPTS "w:xP:O:o:E"
+
+/* Hardware events counted with config.counters */
+#define BENCH_INSTRUCTIONS  0
+#define BENCH_CACHE_MISSES  1   /* last-level cache */
+#define BENCH_BRANCH_MISSES 2
+#define BENCH_DTLB_MISSES   3   /* data TLB, loads */
+#define BENCH_NCOUNTERS     4
+
+/* The function that bench_run times */
+typedef void (*bench_funct)(void *);
+
+/* How to take the samples; bench_init fills in the defaults */
+typedef struct {
+	int warmup;         /* untimed runs before the first sample (1) */
+	int kbest;          /* stop once the kbest smallest samples agree (3),
+	                       or 0 to take exactly minsamples */
+	double epsilon;     /* ... to within this fraction (0.01) */
+	int minsamples;     /* take at least this many samples (3) */
+	int maxsamples;     /* and give up after this many (20) */
+	double outlier;     /* reject samples more than this many MADs above
+	                       the median (3), or 0 to keep them all */
+	int flush;          /* evict the caches before each sample (0) */
+	int flush_bytes;    /* size of the buffer written to do that (8MB) */
+	int cpu;            /* CPU to pin the process to, or -1 (-1) */
+	int format;         /* BENCH_TEXT, BENCH_CSV or BENCH_JSON */
+	int counters;       /* count hardware events too (0) */
+} bench_config_t;
+
+/* What the samples of one benchmark came to, in cycles */
+typedef struct {
+	int samples;        /* samples taken, not counting warmup runs */
+	int kept;           /* samples left after rejecting outliers */
+	double best;        /* the smallest sample: the K-best estimate */
+	double median;
+	double mean;        /* of the kept samples */
+	double stddev;
+	double ci95;        /* half-width of the 95% confidence interval */
+	double counters[BENCH_NCOUNTERS];  /* mean events of the kept
+	                       samples, or -1 where they were not counted */
+} bench_result_t;
+
+/* One run of a benchmark */
+typedef struct {
+	double cycles;
+	double counters[BENCH_NCOUNTERS];  /* -1 if not counted */
+} bench_sample_t;
+
+/* A benchmark in progress */
+typedef struct {
+	const bench_config_t *config;
+	bench_sample_t *samples;  /* sorted by cycles, smallest first */
+	int nsamples;
+	int nwarm;          /* warmup runs done so far */
+	uint64_t start;     /* cycle counter at bench_begin */
+} bench_t;
+
+/*
+ * bench_cycles - read the processor's time-stamp counter
+ */
+static inline uint64_t bench_cycles(void)
+{
+	unsigned hi, lo;
+
+	asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* Configuration */
+void bench_init(bench_config_t *config);
+int bench_option(bench_config_t *config, int ch, const char *arg);
+void bench_usage(FILE *fp);
+int bench_pin(int cpu);
+double bench_mhz(void);
+
+/* Sampling */
+void bench_start(bench_t *b, const bench_config_t *config);
+int bench_more(bench_t *b);
+void bench_begin(bench_t *b);
+void bench_end(bench_t *b);
+void bench_add(bench_t *b, double cycles);
+void bench_finish(bench_t *b, bench_result_t *result);
+double bench_run(const bench_config_t *config, bench_funct f, void *argp,
+		bench_result_t *result);
+
+/* Reporting */
+void bench_header(FILE *fp, const bench_config_t *config);
+void bench_report(FILE *fp, const bench_config_t *config, const char *name,
+		long n, const bench_result_t *result);
+void bench_footer(FILE *fp, const bench_config_t *config);
+void bench_counter_header(FILE *fp, const bench_config_t *config);
+void bench_counter_columns(FILE *fp, const bench_config_t *config, long n,
+		const bench_result_t *result);
+
+#endif /* __BENCH_H_ */
@@ -1,11 +1,17 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
 
+#include "bench.h"
 #include "config.h"
 #include "records.h"
-#include "realtime.h"
+
+
+/*! How each size is sampled and reported; see ../../bench/bench.h. */
+bench_config_t bench_config;
 
 
 /*!
@@ -21,43 +27,71 @@ int compare_records(const void *a, const void *b) {
 
 
 /*!
- * Runs the performance test for a given number of records and a given
- * number of repetitions.  Returns the average total time taken.
+ * Runs the performance test for a given number of records, as many times
+ * as bench_config asks for, and summarizes the times taken in result.
  */
-uint64_t sort_perf(int num_records, int num_repeats) {
-    uint64_t total = 0;
-    for (int rep = 0; rep < num_repeats; rep++) {
+void sort_perf(int num_records, bench_result_t *result) {
+    bench_t bench;
+    bench_start(&bench, &bench_config);
+    while (bench_more(&bench)) {
         // Generate the array of records to be sorted.
         record_t *records = generate_records(num_records);
 
-        uint64_t start = rdtsc();
+        bench_begin(&bench);
         qsort(records, num_records, sizeof(record_t), compare_records);
-        uint64_t end = rdtsc();
+        bench_end(&bench);
 
         free(records);
-
-        total += end - start;
     }
-
-    uint64_t avg = total / num_repeats;
-    return avg;
+    bench_finish(&bench, result);
 }
 
 
 /*! Main entry point for the program. */
-int main() {
+int main(int argc, char **argv) {
+    int ch;
+
+    // NUM_REPEATS samples of each size, unless the options say otherwise.
+    bench_init(&bench_config);
+    bench_config.kbest = 0;
+    bench_config.minsamples = NUM_REPEATS;
+    while ((ch = getopt(argc, argv, BENCH_OPTS)) != -1) {
+        if (!bench_option(&bench_config, ch, optarg)) {
+            fprintf(stderr, "usage: %s [options]\n", argv[0]);
+            bench_usage(stderr);
+            exit(1);
+        }
+    }
+
     srandom(RANDOM_SEED);
 
     fprintf(stderr, "Sorting an array of records\n");
 
-    printf("N\tTotal Time\tClocks per Element\n");
+    if (bench_config.format == BENCH_TEXT) {
+        printf("N\tTotal Time\tClocks per Element");
+        bench_counter_header(stdout, &bench_config);
+        printf("\n");
+    }
+    else {
+        bench_header(stdout, &bench_config);
+    }
 
     for (int num_records = N_START; num_records <= N_END; num_records += N_STEP) {
-        uint64_t avg_time = sort_perf(num_records, NUM_REPEATS);
-        float avg_cpe = (float) avg_time / (float) num_records;
-        printf("%d\t%" PRIu64 "\t%.2f\n", num_records, avg_time, avg_cpe);
+        bench_result_t result;
+        sort_perf(num_records, &result);
+        if (bench_config.format == BENCH_TEXT) {
+            uint64_t avg_time = (uint64_t) result.mean;
+            float avg_cpe = (float) avg_time / (float) num_records;
+            printf("%d\t%" PRIu64 "\t%.2f", num_records, avg_time, avg_cpe);
+            bench_counter_columns(stdout, &bench_config, num_records, &result);
+            printf("\n");
+        }
+        else {
+            bench_report(stdout, &bench_config, "sort_records", num_records,
+                &result);
+        }
     }
+    bench_footer(stdout, &bench_config);
 
     return 0;
 }
-
@@ -0,0 +1,39 @@
+/*
+ * bintrace.h - binary trace format that mdriver maps into memory and
+ *     replays in place; rep2bin converts .rep text traces into it
+ *
+ * A trace is a bintrace_header_t followed by num_ops bintrace_op_t
+ * records, which mdriver uses as its request array without copying.
+ * All fields are in the byte order of the machine that wrote the file.
+ */
+#ifndef __BINTRACE_H_
+#define __BINTRACE_H_
+
+#include <stdint.h>
+
+#define BINTRACE_MAGIC   0x5442444du  /* "MDBT" when read as bytes */
+#define BINTRACE_VERSION 1
+
+/* Request types, the same as mdriver's ALLOC, FREE and REALLOC */
+#define BINTRACE_ALLOC   0
+#define BINTRACE_FREE    1
+#define BINTRACE_REALLOC 2
+
+/* The four header lines of a .rep file, plus the magic number */
+typedef struct {
+	uint32_t magic;          /* BINTRACE_MAGIC */
+	uint32_t version;        /* BINTRACE_VERSION */
+	int32_t weight;          /* weight for this trace */
+	int32_t ignore_ranges;   /* don't check ranges */
+	int32_t num_ids;         /* number of alloc/realloc ids */
+	int32_t num_ops;         /* number of requests that follow */
+} bintrace_header_t;
+
+/* One request line of a .rep file */
+typedef struct {
+	int32_t type;            /* BINTRACE_ALLOC, ... */
+	int32_t index;           /* block id */
+	uint64_t size;           /* byte size of alloc/realloc request */
+} bintrace_op_t;
+
+#endif /* __BINTRACE_H_ */
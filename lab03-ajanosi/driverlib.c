@@ -251,7 +251,11 @@ int submitr(char *hostname,    /* Server domain name */
     }
 
     /* Construct the HTTP request */
-    sprintf(buf, "GET /%s/submitr.pl/?userid=%s&lab=%s&result=%s&submit=submit HTTP/1.0\r\n\r\n", course, userid, lab, enc_result);
+    if (snprintf(buf, sizeof(buf), "GET /%s/submitr.pl/?userid=%s&lab=%s&result=%s&submit=submit HTTP/1.0\r\n\r\n", course, userid, lab, enc_result) >= (int)sizeof(buf)) {
+	strcpy(status_msg, "Error: HTTP request too large. Increase SUBMITR_MAXBUF");
+	close(clientfd);
+	return -1;
+    }
 
     /* Send the request to the server */
     if (rio_writen(clientfd, buf, strlen(buf)) < 0) {
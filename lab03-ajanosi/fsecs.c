@@ -2,34 +2,32 @@
  * High-level timing wrappers
  ****************************/
 #include <stdio.h>
+#include <string.h>
 #include "fsecs.h"
-#include "fcyc.h"
-#include "clock.h"
 #include "ftimer.h"
 #include "config.h"
 
 static double Mhz;  /* estimated CPU clock frequency */
+static bench_config_t config;  /* how the bench harness samples */
 
 extern int verbose; /* -v option in mdriver.c */
 
 /*
- * init_fsecs - initialize the timing package
+ * init_fsecs - initialize the timing package, with the sampling
+ *     parameters of the bench harness in bench_config
  */
-void init_fsecs(void)
+void init_fsecs(const bench_config_t *bench_config)
 {
     Mhz = 0; /* keep gcc -Wall happy */
+    config = *bench_config;
 
 #if USE_FCYC
     if (verbose)
 	printf("Measuring performance with a cycle counter.\n");
 
-    /* set key parameters for the fcyc package */
-    set_fcyc_maxsamples(20); 
-    set_fcyc_clear_cache(1);
-    set_fcyc_compensate(1);
-    set_fcyc_epsilon(0.01);
-    set_fcyc_k(3);
-    Mhz = mhz(verbose > 0);
+    Mhz = bench_mhz();
+    if (verbose > 1)
+	printf("Processor clock rate ~= %.1f MHz\n", Mhz);
 #elif USE_ITIMER
     if (verbose)
 	printf("Measuring performance with the interval timer.\n");
@@ -40,18 +38,22 @@ void init_fsecs(void)
 }
 
 /*
- * fsecs - Return the running time of a function f (in seconds)
+ * fsecs - Return the running time of a function f (in seconds), and
+ *     the statistics of its samples in cycles if result is not NULL
+ *     (all zero unless the cycle counter is used)
  */
-double fsecs(fsecs_test_funct f, void *argp) 
+double fsecs(fsecs_test_funct f, void *argp, bench_result_t *result)
 {
 #if USE_FCYC
-    double cycles = fcyc(f, argp);
+    double cycles = bench_run(&config, f, argp, result);
     return cycles/(Mhz*1e6);
-#elif USE_ITIMER
+#else
+    if (result != NULL)
+	memset(result, 0, sizeof(*result));
+#if USE_ITIMER
     return ftimer_itimer(f, argp, 10);
 #elif USE_GETTOD
     return ftimer_gettod(f, argp, 10);
 #endif 
+#endif
 }
-
-
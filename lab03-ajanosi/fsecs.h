@@ -1,4 +1,6 @@
+#include "bench.h"
+
 typedef void (*fsecs_test_funct)(void *);
 
-void init_fsecs(void);
-double fsecs(fsecs_test_funct f, void *argp);
+void init_fsecs(const bench_config_t *bench_config);
+double fsecs(fsecs_test_funct f, void *argp, bench_result_t *result);
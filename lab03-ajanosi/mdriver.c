@@ -10,14 +10,22 @@
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
+#include <limits.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef THREADSAFE
+#include <pthread.h>
+#endif
 
 #ifndef __GCC__
 #  define __attribute__(args)
@@ -28,6 +36,8 @@
 #include "fsecs.h"
 #include "config.h"
 #include "driverlib.h"
+#include "mmtrace.h"
+#include "bintrace.h"
 
 /**********************
  * Constants and macros
@@ -60,12 +70,15 @@ typedef struct range_t {
 	int index;             /* same index as free; for debugging */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-	enum { ALLOC, FREE, REALLOC } type; /* type of request */
-	int index;                        /* index for free() to use later */
-	size_t size;                      /* byte size of alloc/realloc request */
-} traceop_t;
+/* Types of trace operations */
+enum { ALLOC = BINTRACE_ALLOC, FREE = BINTRACE_FREE, REALLOC = BINTRACE_REALLOC };
+
+/*
+ * Characterizes a single trace operation (allocator request). This is
+ * the record of a binary trace, so those can be replayed straight from
+ * the mapped file.
+ */
+typedef bintrace_op_t traceop_t;
 
 /* Holds the information for one trace file*/
 typedef struct {
@@ -75,6 +88,8 @@ typedef struct {
 	int num_ops;         /* number of distinct requests */
 	int weight;          /* weight for this trace (unused) */
 	traceop_t *ops;      /* array of requests */
+	void *map;           /* mapping of a binary trace that ops points into */
+	size_t map_size;
 	char **blocks;       /* array of ptrs returned by malloc/realloc... */
 	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
 	int *block_rand_base;/* index into random_data, if debug is on */
@@ -103,10 +118,34 @@ typedef struct {
 
 	/* defined only for the student malloc package */
 	double util;     /* space utilization for this trace (always 0 for libc) */
+	double mt_secs;  /* secs for the multi-threaded replay (-T), if run */
+	long sbrks[2];   /* mem_sbrk calls per heap extension policy (-e) */
+	size_t peak[2];  /* peak heap size per heap extension policy (-e) */
+	int def_valid;   /* correct with deferred coalescing (-C)? */
+	double def_util; /* util with deferred coalescing (-C) */
+	double def_secs; /* secs with deferred coalescing (-C) */
+	bench_result_t bench; /* cycles of the samples behind secs */
 
 	/* Note: secs and util are only defined if valid is true */
 } stats_t;
 
+/*
+ * Latency histograms of the instrumented replay (-L). Requests are
+ * classed by operation and by request size, rounded up to a power of
+ * two; the cycles each one took go into log-linear buckets, LAT_SUB
+ * per power of two, so a percentile is off by at most 1/LAT_SUB.
+ */
+#define LAT_OPS      3                    /* ALLOC, FREE, REALLOC */
+#define LAT_CLASSES 32                    /* size classes 2^0 .. 2^31 */
+#define LAT_SUBBITS  3
+#define LAT_SUB      (1 << LAT_SUBBITS)   /* buckets per power of two */
+#define LAT_BUCKETS  (LAT_SUB * 48)       /* up to 2^47 cycles */
+
+typedef struct {
+	long count[LAT_OPS][LAT_CLASSES][LAT_BUCKETS];
+	long total[LAT_OPS][LAT_CLASSES];
+} latency_t;
+
 
 /********************
  * For debugging.  If debug-mode is on, then we have each block start
@@ -135,6 +174,28 @@ int onetime_flag = 0;
 /* by default, no timeouts */
 static int set_timeout = 0;
 
+/* threads for the multi-threaded replay (-T); 0 means don't run it */
+static int mt_threads = 0;
+
+/* traces run at once in forked workers (-j); 0 means run them in turn */
+static int jobs = 0;
+
+/* if set, compare the heap extension policies of mm.c (-e) */
+static int compare_extend = 0;
+
+/* if set, compare immediate and deferred coalescing in mm.c (-C) */
+static int compare_coalesce = 0;
+
+/* ops between heap fragmentation reports (-F); 0 means no reports */
+static int frag_interval = 0;
+
+/* CSV file for the latency histograms (-L); NULL means don't time them */
+static FILE *latency_csv = NULL;
+static latency_t *latency_all = NULL;  /* summed over all the traces */
+
+/* how the timed runs are sampled and reported (-w, -x, -P, -O, -o) */
+static bench_config_t bench_config;
+
 
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
@@ -165,6 +226,8 @@ static void randomize_block(trace_t *trace, int index);
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
 		const char *filename);
+static void read_mmtrace(trace_t *trace, FILE *tracefile);
+static void map_bintrace(trace_t *trace, FILE *tracefile);
 static void reinit_trace(trace_t *trace);
 static void free_trace(trace_t *trace);
 
@@ -175,11 +238,21 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum);
+static double eval_mm_util(trace_t *trace, int tracenum, int report);
 static void eval_mm_speed(void *ptr);
+#ifdef THREADSAFE
+static double eval_mm_mt_speed(trace_t *trace, int nthreads);
+#endif
+static void eval_mm_latency(trace_t *trace, latency_t *lat);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printmtresults(int n, stats_t *stats);
+static void printextendresults(int n, stats_t *stats);
+static void printcoalesceresults(int n, stats_t *stats);
+static void printlatresults(const latency_t *lat);
+static void printheapstats(const trace_t *trace, int opnum, int total_size);
+static void writelatcsv(FILE *fp, const char *name, const latency_t *lat);
 static void usage(void);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
 	__attribute__((format(printf, 3,4)));
@@ -228,17 +301,122 @@ static void run_tests(int num_tracefiles, const char *tracedir,
 		if (mm_stats[i].valid) {
 			if (verbose > 1)
 				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i);
+			if (compare_extend) {
+				/* run the util pass under each policy, default last */
+				mm_set_extend_policy(EXTEND_FIXED);
+				eval_mm_util(trace, i, 0);
+				mm_stats[i].sbrks[EXTEND_FIXED] = mem_sbrk_calls();
+				mm_stats[i].peak[EXTEND_FIXED] = mem_peak_heapsize();
+				mm_set_extend_policy(EXTEND_ADAPTIVE);
+			}
+			mm_stats[i].util = eval_mm_util(trace, i, 1);
+			mm_stats[i].sbrks[EXTEND_ADAPTIVE] = mem_sbrk_calls();
+			mm_stats[i].peak[EXTEND_ADAPTIVE] = mem_peak_heapsize();
 			speed_params->trace = trace;
 			speed_params->ranges = ranges;
 			if (verbose > 1)
 				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, speed_params);
+			mm_stats[i].secs = fsecs(eval_mm_speed, speed_params,
+					&mm_stats[i].bench);
+#ifdef THREADSAFE
+			if (mt_threads > 0) {
+				if (verbose > 1)
+					printf("Replaying on %d threads.\n", mt_threads);
+				mm_stats[i].mt_secs = eval_mm_mt_speed(trace, mt_threads);
+			}
+#endif
+			if (latency_csv != NULL) {
+				if (verbose > 1)
+					printf("Timing each request.\n");
+				eval_mm_latency(trace, latency_all);
+			}
+			if (compare_coalesce) {
+				if (verbose > 1)
+					printf("Checking deferred coalescing for correctness, "
+							"efficiency, and performance.\n");
+				mm_set_coalesce_policy(COALESCE_DEFERRED);
+				mm_stats[i].def_valid = eval_mm_valid(trace, &ranges);
+				if (mm_stats[i].def_valid) {
+					mm_stats[i].def_util = eval_mm_util(trace, i, 0);
+					mm_stats[i].def_secs = fsecs(eval_mm_speed, speed_params,
+							NULL);
+				}
+				mm_set_coalesce_policy(COALESCE_IMMEDIATE);
+			}
 		}
 		free_trace(trace);
 	}
 }
 
+/*
+ * run_tests_parallel - Run the tests like run_tests, but each trace in a
+ *     forked worker with its own copy of the simulated heap, up to jobs
+ *     workers at a time. Each worker sends its stats and error count back
+ *     through a pipe; a worker that dies leaves its trace marked invalid.
+ */
+static void run_tests_parallel(int num_tracefiles, const char *tracedir,
+		char **tracefiles, stats_t *mm_stats, int jobs) {
+	pid_t *pids = calloc(num_tracefiles, sizeof(pid_t));
+	int *fds = calloc(num_tracefiles, sizeof(int));
+	int next = 0, running = 0;
+	int i, fd[2], status, child_errors;
+	speed_t speed_params;
+	pid_t pid;
+
+	if (pids == NULL || fds == NULL)
+		unix_error("calloc failed in run_tests_parallel");
+
+	while (next < num_tracefiles || running > 0) {
+		/* start workers until jobs are running */
+		while (next < num_tracefiles && running < jobs) {
+			if (pipe(fd) < 0)
+				unix_error("pipe failed in run_tests_parallel");
+			if ((pid = fork()) < 0)
+				unix_error("fork failed in run_tests_parallel");
+			if (pid == 0) {
+				close(fd[0]);
+				run_tests(1, tracedir, &tracefiles[next], &mm_stats[next],
+						NULL, &speed_params);
+				if (write(fd[1], &mm_stats[next], sizeof(stats_t))
+						!= sizeof(stats_t) ||
+						write(fd[1], &errors, sizeof(errors))
+						!= sizeof(errors))
+					_exit(1);
+				_exit(0);
+			}
+			close(fd[1]);
+			pids[next] = pid;
+			fds[next] = fd[0];
+			next++;
+			running++;
+		}
+
+		/* collect whichever worker finishes first */
+		if ((pid = wait(&status)) < 0)
+			unix_error("wait failed in run_tests_parallel");
+		for (i = 0; i < next && pids[i] != pid; i++)
+			;
+		if (i == next)
+			continue;
+		running--;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+				read(fds[i], &mm_stats[i], sizeof(stats_t))
+				!= sizeof(stats_t) ||
+				read(fds[i], &child_errors, sizeof(child_errors))
+				!= sizeof(child_errors)) {
+			printf("ERROR: the worker for trace %s failed\n", tracefiles[i]);
+			strcpy(mm_stats[i].filename, tracefiles[i]);
+			mm_stats[i].valid = 0;
+			child_errors = 1;
+		}
+		errors += child_errors;
+		close(fds[i]);
+	}
+
+	free(pids);
+	free(fds);
+}
+
 /**************
  * Main routine
  **************/
@@ -269,7 +447,10 @@ int main(int argc, char **argv)
 	/*
 	 * Read and interpret the command line arguments
 	 */
-	while ((c = getopt(argc, argv, "d:f:c:s:t:hAlD")) != EOF) {
+	bench_init(&bench_config);
+	bench_config.flush = 1;  /* cold caches, as fcyc ran it */
+	while ((c = getopt(argc, argv, "d:f:c:s:t:T:L:F:j:CehAlD" BENCH_OPTS))
+			!= EOF) {
 		switch (c) {
 
 			case 'A': /* Hidden Autolab driver argument */
@@ -303,6 +484,36 @@ int main(int argc, char **argv)
 					strcat(tracedir, "/"); /* path always ends with "/" */
 				break;
 
+			case 'e': /* Compare the heap extension policies */
+				compare_extend = 1;
+				break;
+
+			case 'F': /* Report on the heap every n ops of the util pass */
+				frag_interval = atoi(optarg);
+				if (frag_interval < 1)
+					app_error("-F needs a positive number of ops\n");
+				break;
+
+			case 'j': /* Run this many traces at once in forked workers */
+				jobs = atoi(optarg);
+				if (jobs < 1)
+					app_error("-j needs a positive number of workers\n");
+				break;
+
+			case 'C': /* Compare immediate and deferred coalescing */
+				compare_coalesce = 1;
+				break;
+
+			case 'L': /* Time each request, write the histograms to a CSV */
+				if ((latency_csv = fopen(optarg, "w")) == NULL)
+					unix_error("ERROR: Could not open %s", optarg);
+				latency_all = calloc(1, sizeof(latency_t));
+				if (latency_all == NULL)
+					unix_error("ERROR: calloc failed in main");
+				fprintf(latency_csv, "trace,op,size_lo,size_hi,"
+						"cycles_lo,cycles_hi,count\n");
+				break;
+
 			case 'l': /* Run libc malloc */
 				run_libc = 1;
 				break;
@@ -319,11 +530,24 @@ int main(int argc, char **argv)
 				set_timeout = atoi(optarg);
 				break;
 
+			case 'T': /* Also replay each trace on this many threads */
+#ifdef THREADSAFE
+				mt_threads = atoi(optarg);
+				if (mt_threads < 1)
+					app_error("-T needs a positive thread count\n");
+#else
+				app_error("-T needs the THREADSAFE build of mm.c "
+						"(make THREADSAFE=1)\n");
+#endif
+				break;
+
 			case 'h': /* Print this message */
 				usage();
 				exit(0);
 
 			default:
+				if (bench_option(&bench_config, c, optarg))
+					break;
 				usage();
 				exit(1);
 		}
@@ -340,7 +564,7 @@ int main(int argc, char **argv)
 	}
 
 	/* Initialize the timing package */
-	init_fsecs();
+	init_fsecs(&bench_config);
 
 	/* Initialize the timeout */
 	if (set_timeout) {
@@ -371,7 +595,8 @@ int main(int argc, char **argv)
 				speed_params.trace = trace;
 				if (verbose > 1)
 					printf("and performance.\n");
-				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params,
+						&libc_stats[i].bench);
 			}
 			free_trace(trace);
 		}
@@ -397,8 +622,23 @@ int main(int argc, char **argv)
 	/* Initialize the simulated memory system in memlib.c */
 	mem_init();
 
-	run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
-			ranges, &speed_params);
+	if (jobs > 0 && !onetime_flag) {
+		if (latency_csv != NULL)
+			app_error("-L cannot be combined with -j\n");
+		/* workers sharing a CPU wreck each other's timings, and fcyc
+		   retries until they agree */
+		if (jobs > sysconf(_SC_NPROCESSORS_ONLN)) {
+			jobs = sysconf(_SC_NPROCESSORS_ONLN);
+			printf("Running %d trace%s at once, one per CPU\n",
+					jobs, jobs == 1 ? "" : "s");
+		}
+		run_tests_parallel(num_tracefiles, tracedir, tracefiles, mm_stats,
+				jobs);
+	}
+	else {
+		run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
+				ranges, &speed_params);
+	}
 
 
 	/* Display the mm results in a compact table */
@@ -414,8 +654,48 @@ int main(int argc, char **argv)
 			printf("\nResults for mm malloc:\n");
 			printresults(num_tracefiles, mm_stats);
 			printf("\n");
+			if (mt_threads > 0) {
+				printf("Results for mm malloc replayed on %d threads:\n",
+						mt_threads);
+				printmtresults(num_tracefiles, mm_stats);
+				printf("\n");
+			}
+			if (compare_extend) {
+				printf("Heap extension policies of mm malloc:\n");
+				printextendresults(num_tracefiles, mm_stats);
+				printf("\n");
+			}
+			if (compare_coalesce) {
+				printf("Immediate and deferred coalescing in mm malloc:\n");
+				printcoalesceresults(num_tracefiles, mm_stats);
+				printf("\n");
+			}
+			if (latency_csv != NULL) {
+				printf("Request latency of mm malloc, all traces:\n");
+				printlatresults(latency_all);
+				printf("\n");
+			}
 		}
 	}
+	if (latency_csv != NULL) {
+		writelatcsv(latency_csv, "all", latency_all);
+		if (fclose(latency_csv) != 0)
+			unix_error("ERROR: Could not write the latency CSV");
+	}
+
+	/* the samples behind each trace's time, for comparing across runs,
+	   and the hardware events per request if they were counted (-E) */
+	if ((bench_config.format != BENCH_TEXT || bench_config.counters) &&
+			!onetime_flag) {
+		if (bench_config.format == BENCH_TEXT)
+			printf("Timing samples of mm malloc, per request:\n");
+		bench_header(stdout, &bench_config);
+		for (i = 0; i < num_tracefiles; i++)
+			if (mm_stats[i].valid)
+				bench_report(stdout, &bench_config, mm_stats[i].filename,
+						(long)mm_stats[i].ops, &mm_stats[i].bench);
+		bench_footer(stdout, &bench_config);
+	}
 
 	/*
 	 * Accumulate the aggregate statistics for the student's mm package
@@ -525,9 +805,8 @@ static int add_range(range_t **ranges, char *lo, int size,
 		return 0;
 	}
 
-	/* The payload must lie within the extent of the heap */
-	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-			(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+	/* The payload must lie within the extent of the heap (of one arena) */
+	if (!mem_in_heap(lo, hi)) {
 		malloc_error(trace, opnum,
 				"Payload (%p:%p) lies outside heap (%p:%p)",
 				lo, hi, mem_heap_lo(), mem_heap_hi());
@@ -676,6 +955,7 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	int index, size;
 	int max_index = 0;
 	int op_index;
+	uint32_t magic;
 
 	if (verbose > 1)
 		printf("Reading tracefile: %s\n", filename);
@@ -690,6 +970,27 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	if ((tracefile = fopen(trace->filename, "r")) == NULL) {
 		unix_error("Could not open %s in read_trace", trace->filename);
 	}
+
+	/*
+	 * Binary traces recorded by mmrecord.so have their own loader, and
+	 * binary traces made by rep2bin are mapped instead of read
+	 */
+	trace->map = NULL;
+	if (fread(&magic, sizeof(magic), 1, tracefile) == 1 &&
+			(magic == MMTRACE_MAGIC || magic == BINTRACE_MAGIC)) {
+		rewind(tracefile);
+		if (magic == MMTRACE_MAGIC)
+			read_mmtrace(trace, tracefile);
+		else
+			map_bintrace(trace, tracefile);
+		fclose(tracefile);
+		strcpy(stats->filename, trace->filename);
+		stats->weight = trace->weight;
+		stats->ops = trace->num_ops;
+		return trace;
+	}
+	rewind(tracefile);
+
 	assert(fscanf(tracefile, "%d", &trace->weight) != EOF);
 	assert(fscanf(tracefile, "%d", &trace->num_ids) != EOF);
 	assert(fscanf(tracefile, "%d", &trace->num_ops) != EOF);
@@ -766,6 +1067,264 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 	return trace;
 }
 
+/*
+ * The address map used by read_mmtrace: an open addressing hash table
+ * with linear probing from recorded block addresses to trace block ids.
+ * Address 0 marks an empty slot.
+ */
+typedef struct {
+	uint64_t *addrs;
+	int *ids;
+	size_t mask;           /* number of slots - 1, a power of two - 1 */
+	size_t count;          /* number of addresses in the map */
+} addrmap_t;
+
+/*
+ * addrmap_slot - the slot that holds addr, or the empty slot where it goes
+ */
+static size_t addrmap_slot(const addrmap_t *map, uint64_t addr)
+{
+	size_t i = (size_t)((addr >> 3) * 0x9e3779b97f4a7c15ull >> 20) & map->mask;
+
+	while (map->addrs[i] != 0 && map->addrs[i] != addr)
+		i = (i + 1) & map->mask;
+	return i;
+}
+
+/*
+ * addrmap_init - make an empty map with room for slots addresses
+ */
+static void addrmap_init(addrmap_t *map, size_t slots)
+{
+	map->addrs = calloc(slots, sizeof(uint64_t));
+	map->ids = malloc(slots * sizeof(int));
+	if (map->addrs == NULL || map->ids == NULL)
+		unix_error("malloc failed in addrmap_init");
+	map->mask = slots - 1;
+	map->count = 0;
+}
+
+/*
+ * addrmap_put - map addr to id; addr must not be in the map
+ */
+static void addrmap_put(addrmap_t *map, uint64_t addr, int id)
+{
+	addrmap_t bigger;
+	size_t i;
+
+	/* keep the table at most half full */
+	if (2 * (map->count + 1) > map->mask + 1) {
+		addrmap_init(&bigger, 2 * (map->mask + 1));
+		for (i = 0; i <= map->mask; i++)
+			if (map->addrs[i] != 0)
+				addrmap_put(&bigger, map->addrs[i], map->ids[i]);
+		free(map->addrs);
+		free(map->ids);
+		*map = bigger;
+	}
+	i = addrmap_slot(map, addr);
+	map->addrs[i] = addr;
+	map->ids[i] = id;
+	map->count++;
+}
+
+/*
+ * addrmap_remove - unmap addr; returns its id, or -1 if it was not mapped
+ */
+static int addrmap_remove(addrmap_t *map, uint64_t addr)
+{
+	size_t i = addrmap_slot(map, addr);
+	size_t j, home;
+	int id;
+
+	if (map->addrs[i] == 0)
+		return -1;
+	id = map->ids[i];
+	map->count--;
+
+	/* shift later entries of the probe run back into the hole */
+	for (j = (i + 1) & map->mask; map->addrs[j] != 0; j = (j + 1) & map->mask) {
+		home = (size_t)((map->addrs[j] >> 3) * 0x9e3779b97f4a7c15ull >> 20)
+			& map->mask;
+		if (((j - home) & map->mask) >= ((j - i) & map->mask)) {
+			map->addrs[i] = map->addrs[j];
+			map->ids[i] = map->ids[j];
+			i = j;
+		}
+	}
+	map->addrs[i] = 0;
+	return id;
+}
+
+/*
+ * add_op - append one request to a trace whose ops array holds *max ops
+ */
+static void add_op(trace_t *trace, int *max, int type, int index, size_t size)
+{
+	if (trace->num_ops == *max) {
+		*max *= 2;
+		trace->ops = realloc(trace->ops, *max * sizeof(traceop_t));
+		if (trace->ops == NULL)
+			unix_error("realloc failed in add_op");
+	}
+	trace->ops[trace->num_ops].type = type;
+	trace->ops[trace->num_ops].index = index;
+	trace->ops[trace->num_ops].size = size;
+	trace->num_ops++;
+}
+
+/*
+ * read_mmtrace - fill in a trace from a binary trace recorded by
+ *     mmrecord.so (see mmtrace.h), streaming it in blocks of records.
+ *     Each recorded block address gets a block id while it is live.
+ *     Frees of blocks that were never seen allocated (e.g. from before
+ *     recording started) and zero-byte requests are skipped.
+ */
+static void read_mmtrace(trace_t *trace, FILE *tracefile)
+{
+	mmtrace_header_t header;
+	mmtrace_rec_t recs[1024];
+	addrmap_t live;
+	size_t n, i;
+	int max_ops = 1024;
+	int skipped = 0;
+	int id, stale;
+
+	if (fread(&header, sizeof(header), 1, tracefile) != 1 ||
+			header.magic != MMTRACE_MAGIC)
+		app_error("%s: not a recorded trace", trace->filename);
+	if (header.version != MMTRACE_VERSION)
+		app_error("%s: recorded trace version %u, expected %u",
+				trace->filename, header.version, MMTRACE_VERSION);
+
+	trace->weight = 1;
+	trace->ignore_ranges = 0;
+	trace->num_ids = 0;
+	trace->num_ops = 0;
+	if ((trace->ops = malloc(max_ops * sizeof(traceop_t))) == NULL)
+		unix_error("malloc failed in read_mmtrace");
+	addrmap_init(&live, 1024);
+
+	while ((n = fread(recs, sizeof(mmtrace_rec_t), 1024, tracefile)) > 0) {
+		for (i = 0; i < n; i++) {
+			mmtrace_rec_t *rec = &recs[i];
+
+			/* the block a realloc moves, or frees if it returns NULL */
+			id = -1;
+			if (rec->op == MMTRACE_FREE || rec->op == MMTRACE_REALLOC)
+				id = addrmap_remove(&live, rec->ptr);
+
+			if (rec->op == MMTRACE_FREE || rec->result == 0 ||
+					rec->size == 0 || rec->size > INT_MAX) {
+				if (id >= 0 && rec->op == MMTRACE_REALLOC && rec->size != 0)
+					addrmap_put(&live, rec->ptr, id);  /* failed realloc */
+				else if (id >= 0)
+					add_op(trace, &max_ops, FREE, id, 0);
+				else
+					skipped++;
+				continue;
+			}
+
+			/* an address can only be handed out again once it is free */
+			if ((stale = addrmap_remove(&live, rec->result)) >= 0)
+				add_op(trace, &max_ops, FREE, stale, 0);
+
+			if (id >= 0) {
+				add_op(trace, &max_ops, REALLOC, id, rec->size);
+			} else {
+				id = trace->num_ids++;
+				add_op(trace, &max_ops, ALLOC, id, rec->size);
+			}
+			addrmap_put(&live, rec->result, id);
+		}
+	}
+	if (ferror(tracefile))
+		unix_error("Could not read %s in read_mmtrace", trace->filename);
+	free(live.addrs);
+	free(live.ids);
+
+	if (verbose > 1)
+		printf("Loaded %d requests on %d blocks, skipped %d records\n",
+				trace->num_ops, trace->num_ids, skipped);
+	if (trace->num_ids == 0)
+		app_error("%s: recorded trace has no allocations", trace->filename);
+
+	trace->blocks = calloc(trace->num_ids, sizeof(char *));
+	trace->block_sizes = calloc(trace->num_ids, sizeof(size_t));
+	trace->block_rand_base = calloc(trace->num_ids,
+			sizeof(*trace->block_rand_base));
+	if (trace->blocks == NULL || trace->block_sizes == NULL ||
+			trace->block_rand_base == NULL)
+		unix_error("calloc failed in read_mmtrace");
+}
+
+/*
+ * map_bintrace - fill in a trace from a binary trace made by rep2bin
+ *     (see bintrace.h). The requests are mapped, not read or parsed, and
+ *     are only scanned once to check that each has a known type and a
+ *     block id in range, since the replay uses them to index the trace's
+ *     block arrays.
+ */
+static void map_bintrace(trace_t *trace, FILE *tracefile)
+{
+	bintrace_header_t header;
+	struct stat st;
+	int i;
+
+	if (fread(&header, sizeof(header), 1, tracefile) != 1 ||
+			header.magic != BINTRACE_MAGIC)
+		app_error("%s: not a binary trace", trace->filename);
+	if (header.version != BINTRACE_VERSION)
+		app_error("%s: binary trace version %u, expected %u",
+				trace->filename, header.version, BINTRACE_VERSION);
+	if (header.weight != 0 && header.weight != 1)
+		app_error("%s: weight can only be zero or one", trace->filename);
+	if (header.ignore_ranges != 0 && header.ignore_ranges != 1)
+		app_error("%s: ignore-ranges can only be zero or one", trace->filename);
+	if (header.num_ids <= 0 || header.num_ops < 0)
+		app_error("%s: bad binary trace header", trace->filename);
+
+	if (fstat(fileno(tracefile), &st) < 0)
+		unix_error("Could not stat %s in map_bintrace", trace->filename);
+	trace->map_size = sizeof(header) +
+		(size_t)header.num_ops * sizeof(traceop_t);
+	if ((size_t)st.st_size < trace->map_size)
+		app_error("%s: binary trace is truncated", trace->filename);
+	trace->map = mmap(NULL, trace->map_size, PROT_READ, MAP_PRIVATE,
+			fileno(tracefile), 0);
+	if (trace->map == MAP_FAILED)
+		unix_error("Could not map %s in map_bintrace", trace->filename);
+	madvise(trace->map, trace->map_size, MADV_SEQUENTIAL);
+
+	trace->weight = header.weight;
+	trace->ignore_ranges = header.ignore_ranges;
+	trace->num_ids = header.num_ids;
+	trace->num_ops = header.num_ops;
+	trace->ops = (traceop_t *)((char *)trace->map + sizeof(header));
+
+	/* only a free may name block -1, which frees NULL */
+	for (i = 0; i < trace->num_ops; i++) {
+		traceop_t *op = &trace->ops[i];
+
+		if (op->type != ALLOC && op->type != FREE && op->type != REALLOC)
+			app_error("%s: request %d has bogus type %d",
+					trace->filename, i, op->type);
+		if (op->index >= trace->num_ids ||
+				op->index < (op->type == FREE ? -1 : 0))
+			app_error("%s: request %d has block id %d, not in [%d, %d)",
+					trace->filename, i, op->index,
+					op->type == FREE ? -1 : 0, trace->num_ids);
+	}
+
+	trace->blocks = calloc(trace->num_ids, sizeof(char *));
+	trace->block_sizes = calloc(trace->num_ids, sizeof(size_t));
+	trace->block_rand_base = calloc(trace->num_ids,
+			sizeof(*trace->block_rand_base));
+	if (trace->blocks == NULL || trace->block_sizes == NULL ||
+			trace->block_rand_base == NULL)
+		unix_error("calloc failed in map_bintrace");
+}
+
 /*
  * reinit_trace - get the trace ready for another run.
  */
@@ -782,7 +1341,10 @@ static void reinit_trace(trace_t *trace)
  */
 static void free_trace(trace_t *trace)
 {
-	free(trace->ops);         /* free the three arrays... */
+	if (trace->map)           /* unmap a binary trace's requests... */
+		munmap(trace->map, trace->map_size);
+	else
+		free(trace->ops);     /* or free the three arrays... */
 	free(trace->blocks);
 	free(trace->block_sizes);
 	free(trace->block_rand_base);
@@ -930,14 +1492,19 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   peak size of the heap in bytes while running the student's malloc
+ *   package on the trace, as mem_peak_heapsize() reports it: all arenas
+ *   and mapped regions at their largest. mem_sbrk() lets the package
+ *   shrink the heap with a negative increment, so the heap at the end
+ *   may be smaller than it ever was; memory given back early does not
+ *   lower the charge.
  *
  *   A higher number is better: 1 is optimal.
+ *
+ *   If report is set and -F was given, the heap is reported on every
+ *   frag_interval ops and after the last one.
  */
-static double eval_mm_util(trace_t *trace, int tracenum)
+static double eval_mm_util(trace_t *trace, int tracenum, int report)
 {
 	int i;
 	int index;
@@ -1014,12 +1581,17 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 		/* update the high-water mark */
 		max_total_size = (total_size > max_total_size) ?
 			total_size : max_total_size;
+
+		if (report && frag_interval > 0 &&
+				((i + 1) % frag_interval == 0 || i + 1 == trace->num_ops))
+			printheapstats(trace, i + 1, total_size);
 	}
 
 	//printf("max_total_size = %f\n", (double)max_total_size);
 	//printf("mem_heapsize = %f\n", (double)mem_heapsize());
 	
-	return ((double)max_total_size / (double)mem_heapsize());
+	/* mm.c may have given memory back, so charge it for its peak */
+	return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 
@@ -1075,6 +1647,291 @@ static void eval_mm_speed(void *ptr)
 		}
 }
 
+#ifdef THREADSAFE
+/* Number of multi-threaded replays; the fastest one is reported */
+#define MT_REPS 3
+
+/* The share of a trace that one thread replays in eval_mm_mt_speed */
+typedef struct {
+	trace_t *trace;
+	int *ops;                  /* indices into trace->ops, in trace order */
+	int num_ops;
+	pthread_barrier_t *start;  /* lines the threads up before timing */
+	struct timespec t0, t1;    /* when this thread started and finished */
+} mtreplay_t;
+
+/*
+ * eval_mm_mt_worker - Replay one thread's share of a trace
+ */
+static void *eval_mm_mt_worker(void *ptr)
+{
+	mtreplay_t *share = (mtreplay_t *)ptr;
+	trace_t *trace = share->trace;
+	int i, j, index, size, newsize;
+	char *p, *newp, *oldp, *block;
+
+	pthread_barrier_wait(share->start);
+	clock_gettime(CLOCK_MONOTONIC, &share->t0);
+
+	for (j = 0;  j < share->num_ops;  j++) {
+		i = share->ops[j];
+		switch (trace->ops[i].type) {
+
+			case ALLOC: /* mm_malloc */
+				index = trace->ops[i].index;
+				size = trace->ops[i].size;
+				if ((p = mm_malloc(size)) == NULL)
+					app_error("mm_malloc error in eval_mm_mt_worker");
+				trace->blocks[index] = p;
+				break;
+
+			case REALLOC: /* mm_realloc */
+				index = trace->ops[i].index;
+				newsize = trace->ops[i].size;
+				oldp = trace->blocks[index];
+				if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
+					app_error("mm_realloc error in eval_mm_mt_worker");
+				trace->blocks[index] = newp;
+				break;
+
+			case FREE: /* mm_free */
+				index = trace->ops[i].index;
+				if(index < 0) {
+					block = 0;
+				} else {
+					block = trace->blocks[index];
+				}
+				mm_free(block);
+				break;
+
+			default:
+				app_error("Nonexistent request type in eval_mm_mt_worker");
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &share->t1);
+	return NULL;
+}
+
+/*
+ * eval_mm_mt_speed - Replay a trace on nthreads threads sharing one mm
+ *    heap and return the wall-clock seconds of the fastest of MT_REPS runs.
+ *    Block ids are dealt round-robin to the threads, and every request on
+ *    an id goes to that id's thread, so each thread replays its blocks in
+ *    trace order while the threads run concurrently.
+ */
+static double eval_mm_mt_speed(trace_t *trace, int nthreads)
+{
+	mtreplay_t *shares;
+	pthread_t *tids;
+	pthread_barrier_t start;
+	double secs, first, last, best = 0;
+	int i, t, rep;
+
+	shares = calloc(nthreads, sizeof(mtreplay_t));
+	tids = calloc(nthreads, sizeof(pthread_t));
+	if (shares == NULL || tids == NULL)
+		unix_error("calloc failed in eval_mm_mt_speed");
+	for (t = 0; t < nthreads; t++) {
+		shares[t].trace = trace;
+		shares[t].start = &start;
+		if ((shares[t].ops = malloc(trace->num_ops * sizeof(int))) == NULL)
+			unix_error("malloc failed in eval_mm_mt_speed");
+	}
+
+	/* split the request stream by block id; free(NULL) goes to thread 0 */
+	for (i = 0;  i < trace->num_ops;  i++) {
+		t = (trace->ops[i].index < 0) ? 0 : trace->ops[i].index % nthreads;
+		shares[t].ops[shares[t].num_ops++] = i;
+	}
+
+	for (rep = 0; rep < MT_REPS; rep++) {
+		reinit_trace(trace);
+		mem_reset_brk();
+		if (mm_init() < 0)
+			app_error("mm_init failed in eval_mm_mt_speed");
+
+		/*
+		 * The threads time themselves: with fewer CPUs than threads they
+		 * can finish before the main thread gets to run again.
+		 */
+		pthread_barrier_init(&start, NULL, nthreads);
+		for (t = 0; t < nthreads; t++) {
+			if ((errno = pthread_create(&tids[t], NULL, eval_mm_mt_worker,
+							&shares[t])) != 0)
+				unix_error("pthread_create failed in eval_mm_mt_speed");
+		}
+		for (t = 0; t < nthreads; t++)
+			pthread_join(tids[t], NULL);
+		pthread_barrier_destroy(&start);
+
+		/* from the first thread starting to the last one finishing */
+		first = last = 0;
+		for (t = 0; t < nthreads; t++) {
+			secs = shares[t].t0.tv_sec + shares[t].t0.tv_nsec / 1e9;
+			if (t == 0 || secs < first)
+				first = secs;
+			secs = shares[t].t1.tv_sec + shares[t].t1.tv_nsec / 1e9;
+			if (t == 0 || secs > last)
+				last = secs;
+		}
+		secs = last - first;
+		if (rep == 0 || secs < best)
+			best = secs;
+	}
+
+	for (t = 0; t < nthreads; t++)
+		free(shares[t].ops);
+	free(shares);
+	free(tids);
+	return best;
+}
+#endif /* def THREADSAFE */
+
+/*
+ * lat_class - the size class of a request: the power of two it rounds up to
+ */
+static int lat_class(size_t size)
+{
+	int class = 0;
+
+	while (class < LAT_CLASSES - 1 && ((size_t)1 << class) < size)
+		class++;
+	return class;
+}
+
+/*
+ * lat_bucket - the histogram bucket of a latency in cycles
+ */
+static int lat_bucket(uint64_t cycles)
+{
+	int msb, b;
+
+	if (cycles < LAT_SUB)
+		return cycles;
+	msb = 63 - __builtin_clzll(cycles);
+	b = (msb - LAT_SUBBITS + 1) * LAT_SUB
+		+ ((cycles >> (msb - LAT_SUBBITS)) & (LAT_SUB - 1));
+	return (b < LAT_BUCKETS) ? b : LAT_BUCKETS - 1;
+}
+
+/*
+ * lat_bucket_lo - the fewest cycles that fall into bucket b
+ */
+static uint64_t lat_bucket_lo(int b)
+{
+	int msb;
+
+	if (b < LAT_SUB)
+		return b;
+	msb = b / LAT_SUB + LAT_SUBBITS - 1;
+	return ((uint64_t)(LAT_SUB + b % LAT_SUB)) << (msb - LAT_SUBBITS);
+}
+
+/*
+ * lat_percentile - the upper bound of the bucket holding the pct-th
+ *     percentile of a histogram with total entries
+ */
+static uint64_t lat_percentile(const long *count, long total, double pct)
+{
+	long seen = 0, rank = (long)(total * pct / 100.0);
+	int b;
+
+	for (b = 0; b < LAT_BUCKETS - 1; b++) {
+		seen += count[b];
+		if (seen > rank)
+			break;
+	}
+	return lat_bucket_lo(b + 1) - 1;
+}
+
+/*
+ * eval_mm_latency - Replay a trace once on a fresh heap, timing each
+ *    request with the time-stamp counter, and add the latencies to lat.
+ *    A free is classed by the size its block was requested with. The
+ *    cost of reading the counter is measured first and subtracted.
+ */
+static void eval_mm_latency(trace_t *trace, latency_t *lat)
+{
+	latency_t *mine;
+	uint64_t t0, t1, cycles, overhead = UINT64_MAX;
+	int i, b, op, class, index, size, newsize;
+	char *p, *newp, *oldp, *block;
+
+	if ((mine = calloc(1, sizeof(latency_t))) == NULL)
+		unix_error("calloc failed in eval_mm_latency");
+	for (i = 0; i < 1000; i++) {
+		t0 = bench_cycles();
+		t1 = bench_cycles();
+		if (t1 - t0 < overhead)
+			overhead = t1 - t0;
+	}
+
+	reinit_trace(trace);
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_latency");
+
+	for (i = 0;  i < trace->num_ops;  i++) {
+		op = trace->ops[i].type;
+		index = trace->ops[i].index;
+		switch (op) {
+
+			case ALLOC: /* mm_malloc */
+				size = trace->ops[i].size;
+				t0 = bench_cycles();
+				p = mm_malloc(size);
+				t1 = bench_cycles();
+				if (p == NULL)
+					app_error("mm_malloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				trace->block_sizes[index] = size;
+				class = lat_class(size);
+				break;
+
+			case REALLOC: /* mm_realloc */
+				newsize = trace->ops[i].size;
+				oldp = trace->blocks[index];
+				t0 = bench_cycles();
+				newp = mm_realloc(oldp,newsize);
+				t1 = bench_cycles();
+				if (newp == NULL && newsize != 0)
+					app_error("mm_realloc error in eval_mm_latency");
+				trace->blocks[index] = newp;
+				trace->block_sizes[index] = newsize;
+				class = lat_class(newsize);
+				break;
+
+			case FREE: /* mm_free */
+				if(index < 0) {
+					block = 0;
+					class = 0;
+				} else {
+					block = trace->blocks[index];
+					class = lat_class(trace->block_sizes[index]);
+				}
+				t0 = bench_cycles();
+				mm_free(block);
+				t1 = bench_cycles();
+				break;
+
+			default:
+				app_error("Nonexistent request type in eval_mm_latency");
+		}
+		cycles = (t1 - t0 > overhead) ? t1 - t0 - overhead : 0;
+		mine->count[op][class][lat_bucket(cycles)]++;
+		mine->total[op][class]++;
+	}
+
+	writelatcsv(latency_csv, trace->filename, mine);
+	for (op = 0; op < LAT_OPS; op++)
+		for (class = 0; class < LAT_CLASSES; class++) {
+			lat->total[op][class] += mine->total[op][class];
+			for (b = 0; b < LAT_BUCKETS; b++)
+				lat->count[op][class][b] += mine->count[op][class][b];
+		}
+	free(mine);
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1239,6 +2096,197 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printmtresults - prints the multi-threaded replay times next to the
+ *     single-threaded ones for each valid trace
+ */
+static void printmtresults(int n, stats_t *stats)
+{
+	int i;
+
+	printf("  %6s%10s%9s%9s  %s\n",
+			"ops", "secs", "Kops", "speedup", "trace");
+	for (i=0; i < n; i++) {
+		if (stats[i].valid && stats[i].mt_secs > 0) {
+			printf("%8.0f%10.6f%9.0f%8.2fx %s\n",
+					stats[i].ops,
+					stats[i].mt_secs,
+					(stats[i].ops/1e3)/stats[i].mt_secs,
+					stats[i].secs/stats[i].mt_secs,
+					stats[i].filename);
+		}
+		else {
+			printf("%8s%10s%9s%9s %s\n", "-", "-", "-", "-",
+					stats[i].filename);
+		}
+	}
+}
+
+/*
+ * printextendresults - prints the sbrk calls and peak heap size of each
+ *     heap extension policy for each valid trace
+ */
+static void printextendresults(int n, stats_t *stats)
+{
+	int i;
+
+	printf("%18s%20s\n", "fixed", "adaptive");
+	printf("%8s%10s%10s%10s  %s\n",
+			"sbrks", "peak", "sbrks", "peak", "trace");
+	for (i=0; i < n; i++) {
+		if (stats[i].valid) {
+			printf("%8ld%10zu%10ld%10zu  %s\n",
+					stats[i].sbrks[EXTEND_FIXED],
+					stats[i].peak[EXTEND_FIXED],
+					stats[i].sbrks[EXTEND_ADAPTIVE],
+					stats[i].peak[EXTEND_ADAPTIVE],
+					stats[i].filename);
+		}
+		else {
+			printf("%8s%10s%10s%10s  %s\n", "-", "-", "-", "-",
+					stats[i].filename);
+		}
+	}
+}
+
+/*
+ * printcoalesceresults - prints the util and throughput of immediate and
+ *     deferred coalescing for each valid trace, and their weighted averages
+ */
+static void printcoalesceresults(int n, stats_t *stats)
+{
+	int i;
+	double sumops = 0, sumsecs[2] = { 0, 0 }, sumutil[2] = { 0, 0 };
+	int sumweight = 0;
+
+	printf("%20s%18s\n", "immediate", "deferred");
+	printf("%8s%9s%8s%9s  %s\n", "util", "Kops", "util", "Kops", "trace");
+	for (i=0; i < n; i++) {
+		if (stats[i].valid && stats[i].def_valid) {
+			printf("%7.0f%%%9.0f%7.0f%%%9.0f  %s\n",
+					stats[i].util*100.0,
+					(stats[i].ops/1e3)/stats[i].secs,
+					stats[i].def_util*100.0,
+					(stats[i].ops/1e3)/stats[i].def_secs,
+					stats[i].filename);
+			sumweight += stats[i].weight;
+			sumops += stats[i].ops * stats[i].weight;
+			sumsecs[0] += stats[i].secs * stats[i].weight;
+			sumsecs[1] += stats[i].def_secs * stats[i].weight;
+			sumutil[0] += stats[i].util * stats[i].weight;
+			sumutil[1] += stats[i].def_util * stats[i].weight;
+		}
+		else {
+			printf("%8s%9s%8s%9s  %s\n", "-", "-", "-", "-",
+					stats[i].filename);
+		}
+	}
+	if (sumweight == 0)
+		sumweight = 1;
+	printf("%7.0f%%%9.0f%7.0f%%%9.0f  (weighted)\n",
+			sumutil[0]/sumweight*100.0,
+			(sumsecs[0] == 0) ? 0 : (sumops/1e3)/sumsecs[0],
+			sumutil[1]/sumweight*100.0,
+			(sumsecs[1] == 0) ? 0 : (sumops/1e3)/sumsecs[1]);
+}
+
+/*
+ * printheapstats - prints where the heap's bytes are after opnum ops of a
+ *     trace, given the payload bytes the trace holds at that point
+ */
+static void printheapstats(const trace_t *trace, int opnum, int total_size)
+{
+	mm_heapstats_t st;
+	int i;
+
+	mm_heapstats(&st);
+	printf("\nheap after %d ops of %s: %zu bytes, %zu mapped, "
+			"%.0f%% payload\n",
+			opnum, trace->filename, st.heap_bytes, st.mapped_bytes,
+			st.heap_bytes + st.mapped_bytes ? 100.0 * total_size
+				/ (st.heap_bytes + st.mapped_bytes) : 0);
+	printf("  allocated %8zu blocks %10zu bytes, %zu padding (%.1f%%)\n",
+			st.alloc_blocks + st.mapped_blocks,
+			st.alloc_bytes + st.mapped_bytes,
+			st.alloc_bytes + st.mapped_bytes - total_size,
+			st.alloc_bytes + st.mapped_bytes ? 100.0 * (st.alloc_bytes
+				+ st.mapped_bytes - total_size)
+				/ (st.alloc_bytes + st.mapped_bytes) : 0);
+	printf("  free      %8zu blocks %10zu bytes, largest %zu, "
+			"external fragmentation %.1f%%\n",
+			st.free_blocks, st.free_bytes, st.largest_free,
+			st.free_bytes ? 100.0 * (1 - (double)st.largest_free
+				/ st.free_bytes) : 0);
+	printf("  free list %8zu blocks, size tree %zu blocks\n",
+			st.list_blocks, st.tree_blocks);
+	printf("  cached    %8zu blocks %10zu bytes\n",
+			st.cached_blocks, st.cached_bytes);
+	printf("  pending   %8zu blocks %10zu bytes\n",
+			st.pending_blocks, st.pending_bytes);
+	printf("  mapped    %8zu blocks %10zu bytes\n",
+			st.mapped_blocks, st.mapped_bytes);
+	printf("  free sizes");
+	for (i = 0; i < MM_HIST_CLASSES; i++)
+		if (st.free_hist[i] > 0)
+			printf(" %zu-%zu:%zu", (size_t)1 << i, ((size_t)2 << i) - 1,
+					st.free_hist[i]);
+	printf("\n");
+}
+
+/* Names of the request types in the latency reports */
+static const char *lat_opname[LAT_OPS] = { "malloc", "free", "realloc" };
+
+/*
+ * printlatresults - prints the median and tail latency in cycles of each
+ *     operation and size class that occurred
+ */
+static void printlatresults(const latency_t *lat)
+{
+	int op, class;
+	const long *count;
+	long total;
+
+	printf("%-8s%14s%10s%10s%10s%10s\n",
+			"op", "size", "count", "p50", "p99", "p99.9");
+	for (op = 0; op < LAT_OPS; op++)
+		for (class = 0; class < LAT_CLASSES; class++) {
+			if ((total = lat->total[op][class]) == 0)
+				continue;
+			count = lat->count[op][class];
+			printf("%-8s%7zu-%-6zu%10ld%10llu%10llu%10llu\n",
+					lat_opname[op],
+					class ? ((size_t)1 << (class - 1)) + 1 : 0,
+					(size_t)1 << class,
+					total,
+					(unsigned long long)lat_percentile(count, total, 50),
+					(unsigned long long)lat_percentile(count, total, 99),
+					(unsigned long long)lat_percentile(count, total, 99.9));
+		}
+	printf("(cycles; each percentile is the upper bound of its bucket)\n");
+}
+
+/*
+ * writelatcsv - writes one CSV row per non-empty histogram bucket
+ */
+static void writelatcsv(FILE *fp, const char *name, const latency_t *lat)
+{
+	int op, class, b;
+
+	for (op = 0; op < LAT_OPS; op++)
+		for (class = 0; class < LAT_CLASSES; class++)
+			for (b = 0; b < LAT_BUCKETS; b++) {
+				if (lat->count[op][class][b] == 0)
+					continue;
+				fprintf(fp, "%s,%s,%zu,%zu,%llu,%llu,%ld\n",
+						name, lat_opname[op],
+						class ? ((size_t)1 << (class - 1)) + 1 : 0,
+						(size_t)1 << class,
+						(unsigned long long)lat_bucket_lo(b),
+						(unsigned long long)lat_bucket_lo(b + 1) - 1,
+						lat->count[op][class][b]);
+			}
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1293,5 +2341,12 @@ static void usage(void)
 	fprintf(stderr, "\t-h         Print this message.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
 	fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
+	fprintf(stderr, "\t-T <n>     Also replay each trace split across n threads.\n");
+	fprintf(stderr, "\t-e         Compare sbrk calls and peak heap of the heap extension policies.\n");
+	fprintf(stderr, "\t-j <n>     Run up to n traces at once, each in its own process (less exact timing).\n");
+	fprintf(stderr, "\t-F <n>     Report on heap fragmentation every n ops of the util pass.\n");
+	fprintf(stderr, "\t-C         Compare util and throughput of immediate and deferred coalescing.\n");
+	fprintf(stderr, "\t-L <file>  Time each request; print p50/p99/p99.9 per op and size, histograms to CSV <file>.\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+	bench_usage(stderr);
 }
@@ -3,6 +3,7 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE  /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -15,25 +16,77 @@
 #include "memlib.h"
 #include "config.h"
 
+/*
+ * Each arena is an independent heap with its own brk, modelled as a
+ * MAX_HEAP-byte slice of one mapping. Arena 0 is the classic single heap
+ * that mem_sbrk, mem_heap_lo and mem_heap_hi operate on.
+ */
+#define ARENA_BASE(i) (heap + (size_t)(i) * MAX_HEAP)
+
+/*
+ * Regions mapped with mem_map live outside the arenas, each in its own
+ * real mapping. They count towards the heap size, so an allocator pays
+ * for them in its utilization like for brk memory.
+ */
+typedef struct {
+    unsigned char *lo;   /* first byte of the region */
+    size_t size;         /* its size, a multiple of the page size */
+} region_t;
+
 /* private variables */
-static unsigned char *heap;
-static unsigned char *mem_brk;
-static unsigned char *mem_max_addr;
+static unsigned char *heap;                   /* start of arena 0 */
+static unsigned char *arena_brk[MAX_ARENAS];  /* brk of each arena */
+static size_t peak_heapsize;                  /* largest mem_heapsize so far */
+static long sbrk_calls;                       /* mem_sbrk calls so far */
+static region_t *regions;                     /* live mem_map regions */
+static int num_regions, max_regions;
+static size_t mapped_bytes;                   /* their total size */
+static volatile int regions_lock;             /* guards the region table */
+
+/*
+ * lock_regions, unlock_regions - serialize the region table, which threads
+ *    of every arena share
+ */
+static void lock_regions(void)
+{
+    while (__sync_lock_test_and_set(&regions_lock, 1))
+	;
+}
+
+static void unlock_regions(void)
+{
+    __sync_lock_release(&regions_lock);
+}
+
+/*
+ * find_region - return the index of the region that starts at lo, or -1;
+ *    called with the region table locked
+ */
+static int find_region(unsigned char *lo)
+{
+    int i;
+
+    for (i = num_regions - 1; i >= 0; i--)
+	if (regions[i].lo == lo)
+	    return i;
+    return -1;
+}
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
+  int i;
   int dev_zero = open("/dev/zero", O_RDWR);
   heap = mmap((void *)0x800000000, /* suggested start*/
-              MAX_HEAP,            /* length */
+              (size_t)MAX_ARENAS * MAX_HEAP, /* length */
               PROT_WRITE,          /* permissions */
-              MAP_PRIVATE,         /* private or shared? */
+              MAP_PRIVATE | MAP_NORESERVE, /* private or shared? */
               dev_zero,            /* fd */
               0);                  /* offset (dunno) */
-  mem_max_addr = heap + MAX_HEAP;
-  mem_brk = heap;                  /* heap is empty initially */
+  for (i = 0; i < MAX_ARENAS; i++)
+    arena_brk[i] = ARENA_BASE(i);  /* heaps are empty initially */
 }
 
 /* 
@@ -41,41 +94,215 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-  munmap(heap, MAX_HEAP);
+  munmap(heap, (size_t)MAX_ARENAS * MAX_HEAP);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointers to make empty heaps,
+ *    and unmap the mem_map regions, along with the peak heap size and
+ *    sbrk call count
  */
 void mem_reset_brk()
 {
-    mem_brk = heap;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	arena_brk[i] = ARENA_BASE(i);
+    for (i = 0; i < num_regions; i++)
+	munmap(regions[i].lo, regions[i].size);
+    num_regions = 0;
+    mapped_bytes = 0;
+    peak_heapsize = 0;
+    sbrk_calls = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap, but never below its start.
  */
 void *mem_sbrk(int incr) 
 {
-    unsigned char *old_brk = mem_brk;
+    return mem_arena_sbrk(0, incr);
+}
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+/*
+ * mem_arena_sbrk - mem_sbrk for one arena. Arenas grow independently, so
+ *    callers only need to serialize calls on the same arena.
+ */
+void *mem_arena_sbrk(int arena, int incr)
+{
+    unsigned char *old_brk = arena_brk[arena];
+    size_t size;
+
+    if ((old_brk + incr) < ARENA_BASE(arena)) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrunk below the heap...\n");
+	return (void *)-1;
+    }
+    if ((old_brk + incr) > ARENA_BASE(arena + 1)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
-    mem_brk += incr;
+    arena_brk[arena] += incr;
+    __sync_fetch_and_add(&sbrk_calls, 1);
+
+    /* racy with other arenas, but only ever read single-threaded */
+    if (incr > 0 && (size = mem_heapsize()) > peak_heapsize)
+	peak_heapsize = size;
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - simple model of mmap: map a region of at least size bytes,
+ *    rounded up to whole pages, outside the arenas. Returns its start,
+ *    which is page aligned, or NULL if it could not be mapped.
+ */
+void *mem_map(size_t size)
+{
+    unsigned char *lo;
+    region_t *grown;
+    size_t pagesize = mem_pagesize();
+
+    size = (size + pagesize - 1) & ~(pagesize - 1);
+    lo = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (lo == MAP_FAILED)
+	return NULL;
+
+    lock_regions();
+    if (num_regions == max_regions) {
+	/* the table is mapped, not malloc'd: with the lock held, a malloc
+	   that lands in an interposed allocator would call back in here */
+	if (max_regions == 0)
+	    grown = mmap(NULL, pagesize, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	else
+	    grown = mremap(regions, max_regions * sizeof(region_t),
+			   2 * max_regions * sizeof(region_t), MREMAP_MAYMOVE);
+	if (grown == MAP_FAILED) {
+	    unlock_regions();
+	    munmap(lo, size);
+	    return NULL;
+	}
+	regions = grown;
+	max_regions = max_regions ? 2 * max_regions : pagesize / sizeof(region_t);
+    }
+    regions[num_regions].lo = lo;
+    regions[num_regions].size = size;
+    num_regions++;
+    mapped_bytes += size;
+    if ((size = mem_heapsize()) > peak_heapsize)
+	peak_heapsize = size;
+    unlock_regions();
+    return lo;
+}
+
+/*
+ * mem_remap - model of mremap: resize the region that starts at lo to at
+ *    least size bytes, moving it if it has to. Returns its new start, or
+ *    NULL if lo is not a region or it could not be resized.
+ */
+void *mem_remap(void *lo, size_t size)
+{
+    unsigned char *newlo;
+    size_t pagesize = mem_pagesize();
+    size_t heapsize;
+    int i;
+
+    size = (size + pagesize - 1) & ~(pagesize - 1);
+    lock_regions();
+    if ((i = find_region(lo)) < 0) {
+	unlock_regions();
+	return NULL;
+    }
+    newlo = mremap(lo, regions[i].size, size, MREMAP_MAYMOVE);
+    if (newlo == MAP_FAILED) {
+	unlock_regions();
+	return NULL;
+    }
+    mapped_bytes += size - regions[i].size;
+    regions[i].lo = newlo;
+    regions[i].size = size;
+    if ((heapsize = mem_heapsize()) > peak_heapsize)
+	peak_heapsize = heapsize;
+    unlock_regions();
+    return newlo;
+}
+
+/*
+ * mem_unmap - model of munmap: give back the region that starts at lo.
+ *    Returns 0, or -1 if lo is not a region.
+ */
+int mem_unmap(void *lo)
+{
+    int i;
+
+    lock_regions();
+    if ((i = find_region(lo)) < 0) {
+	unlock_regions();
+	errno = EINVAL;
+	return -1;
+    }
+    munmap(regions[i].lo, regions[i].size);
+    mapped_bytes -= regions[i].size;
+    regions[i] = regions[--num_regions];
+    unlock_regions();
+    return 0;
+}
+
+/*
+ * mem_arena_lo - return address of the first byte of an arena
+ */
+void *mem_arena_lo(int arena)
+{
+    return (void *)ARENA_BASE(arena);
+}
+
+/*
+ * mem_arena_hi - return address of the last byte of an arena
+ */
+void *mem_arena_hi(int arena)
+{
+    return (void *)(arena_brk[arena] - 1);
+}
+
+/*
+ * mem_arena_of - return the arena that contains addr
+ */
+int mem_arena_of(void *addr)
+{
+    return (int)(((unsigned char *)addr - heap) / MAX_HEAP);
+}
+
+/*
+ * mem_in_heap - return true if lo..hi lies inside the used part of one arena
+ *    or inside one mem_map region
+ */
+int mem_in_heap(void *lo, void *hi)
+{
+    unsigned char *l = lo, *h = hi;
+    int arena, i, found = 0;
+
+    if (h < l)
+	return 0;
+    if (l >= heap && (arena = mem_arena_of(lo)) < MAX_ARENAS)
+	return h < arena_brk[arena];
+
+    lock_regions();
+    for (i = 0; i < num_regions && !found; i++)
+	found = l >= regions[i].lo && h < regions[i].lo + regions[i].size;
+    unlock_regions();
+    return found;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo()
 {
-    return (void *)heap;
+    return mem_arena_lo(0);
 }
 
 /* 
@@ -83,15 +310,39 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return mem_arena_hi(0);
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_heapsize() - returns the heap size in bytes, summed over all arenas,
+ *    plus the size of the mem_map regions
  */
 size_t mem_heapsize() 
 {
-    return (size_t)((void *)mem_brk - (void *)heap);
+    size_t size = mapped_bytes;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	size += (size_t)(arena_brk[i] - ARENA_BASE(i));
+    return size;
+}
+
+/*
+ * mem_peak_heapsize() - returns the largest heap size, as mem_heapsize
+ *    counts it, since the last mem_reset_brk
+ */
+size_t mem_peak_heapsize()
+{
+    return peak_heapsize;
+}
+
+/*
+ * mem_sbrk_calls() - returns the number of mem_sbrk calls, growing or
+ *    shrinking, since the last mem_reset_brk
+ */
+long mem_sbrk_calls()
+{
+    return sbrk_calls;
 }
 
 /*
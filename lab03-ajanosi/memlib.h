@@ -1,5 +1,8 @@
 #include <unistd.h>
 
+/* Number of independent heaps (arenas) the memory model provides */
+#define MAX_ARENAS 8
+
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
@@ -8,4 +11,15 @@ void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_peak_heapsize(void);
+long mem_sbrk_calls(void);
+
+void *mem_arena_sbrk(int arena, int incr);
+void *mem_arena_lo(int arena);
+void *mem_arena_hi(int arena);
+int mem_arena_of(void *addr);
+int mem_in_heap(void *lo, void *hi);
 
+void *mem_map(size_t size);
+void *mem_remap(void *lo, size_t size);
+int mem_unmap(void *lo);
@@ -2,16 +2,19 @@
  * Overview:
  *
  * Block structure:
- * Block have a header and a footer that store the size of the block and if the
- * block is allocated or not (0 if not and anything else otherwise). Allocated
- * blocks have a payload that stores the allocated information say when malloc
- * is called. Free blocks have an empty payload that stores two pointers: a
- * pointer to the previous free block and the next free block. Allocated blocks
- * store the information after these pointers, but they are not used in the free
- * list since allocated. This is how we create the explicit list that is stored
- * in the heap. Free blocks will have 24 bytes (4 header + 4 footer
- * + 2 * 8 pointer) already and additional space in the payload, and allocated
- * blocks will just hold the information assigned to that block.
+ * Every block has a header that stores the size of the block, if the block is
+ * allocated or not (bit 0), and if the block before it is allocated or not
+ * (bit 1, PREV_ALLOC). Only free blocks have a footer with their size, since
+ * coalesce only needs to find the start of a previous block when that block is
+ * free, and the PREV_ALLOC bit says so without looking at it. Allocated blocks
+ * are a header and a payload that stores the allocated information say when
+ * malloc is called, so the payload runs into the word where the footer would
+ * be. Free blocks have an empty payload that stores two pointers: a pointer to
+ * the previous free block and the next free block. This is how we create the
+ * explicit list that is stored in the heap. Free blocks will have 24 bytes
+ * (4 header + 4 footer + 2 * 8 pointer) already and additional space in the
+ * payload, so every block is at least 24 bytes, and allocated blocks will just
+ * hold the information assigned to that block after the header.
  *
  * Organization of the free list:
  * The free list is initially NULL, which is set as a global pointer. When
@@ -20,6 +23,16 @@
  * in order of how new the free block is. By creating a list like this, we have
  * quick traversal in find_fit to find the free block of a certain size.
  *
+ * Size tree:
+ * Free blocks of TREE_MIN bytes or more are not kept in the list but in a
+ * red-black tree keyed on block size, so find_fit takes the best fit among
+ * them in O(log n) instead of scanning every large free block. The tree links
+ * and color live in the free block's payload after PVFR and NXFR. Blocks of a
+ * size that is already in the tree are chained behind that node through
+ * PVFR/NXFR, so the tree has one node per distinct size and taking a chained
+ * block never has to rebalance. Small requests that find nothing in the list
+ * take the smallest block in the tree.
+ *
  * Allocator and the free list:
  * As stated, the free list starts as NULL when the heap is initialized in
  * mm_init. Most of the updating then happens in coalesce. When the first
@@ -30,12 +43,89 @@
  * there are adjacent free blocks to join as one. The functions add_free_block
  * and remove_free_block handle updating the free list, which are called in
  * coalesce and put.
+ *
+ * Segregated free lists:
+ * When built with -DSEGLIST (make SEGLIST=1), the single free list is split
+ * into NUM_CLASSES lists, one per power-of-two size class. A free block lives
+ * in the list for the class of its size, so add_free_block and
+ * remove_free_block only have to pick the right root. find_fit does first-fit
+ * in the class of the request and then takes the head of the next nonempty
+ * larger class, since every block there is big enough. A bitmap of the
+ * nonempty classes makes that a single bit scan, which keeps malloc close to
+ * constant time on fragmented traces.
+ *
+ * Small-block cache:
+ * Freed blocks of up to CACHE_MAX bytes do not go through coalesce but into
+ * exact-size bins, one per 8-byte block size, as allocated blocks chained
+ * through their first payload word. A malloc of that size pops the bin
+ * without calling find_fit. A miss refills the bin from find_fit/place with
+ * a batch that starts at one block and doubles on each further miss up to
+ * CACHE_BATCH, and the extra blocks only come from free space the heap
+ * already has. A bin that reaches CACHE_LIMIT is flushed by half back through
+ * coalesce, and its batch halves. Every DRAIN_PERIOD cached frees all bins
+ * are drained, and heap_malloc reclaims the cached blocks of its arena before
+ * it grows the heap, so cached blocks do not hold the heap fragmented for
+ * long. A block that realloc moves is freed past the cache.
+ *
+ * Thread safety:
+ * When built with -DTHREADSAFE (make THREADSAFE=1), one mutex guards the heap
+ * and the cache is per thread, with bins up to a larger CACHE_MAX that are
+ * refilled in larger batches under one lock acquisition. A thread's cache is
+ * flushed when the thread exits; heap_malloc cannot reclaim the caches of
+ * other threads. mm_init must run before any thread allocates, and only resets the
+ * cache of the calling thread.
+ *
+ * Arenas:
+ * All heap state (free list roots, brk region, lock) lives in an arena_t.
+ * With -DNUM_ARENAS=n (make THREADSAFE=1 ARENAS=n) there are n independent
+ * heaps, each growing its own memlib arena under its own lock. Threads are
+ * handed arenas round-robin the first time they allocate, so up to n threads
+ * allocate without contending. A block is always freed back into the arena
+ * its address belongs to, whichever thread frees it. Arenas other than the
+ * first are only set up when a thread first allocates from them.
+ *
+ * Heap extension:
+ * With the EXTEND_FIXED policy the heap grows by CHUNKSIZE, or by the request
+ * when that is bigger, as in the textbook. The default EXTEND_ADAPTIVE policy
+ * sizes each extension from the arena's recent history instead. Each arena
+ * keeps a running average of its request sizes and a chunk size: when the
+ * heap has to grow again after only a few allocations the chunk doubles, up
+ * to EXTEND_RATIO average requests and 1/EXTEND_SHARE of the heap, and when
+ * growth has become rare it halves back towards CHUNKSIZE. A free block at
+ * the end of the heap counts towards a chunk, since extend_heap merges the
+ * two, but a request larger than a chunk grows the heap by all of its size
+ * and leaves that free block to the small requests after it. When a free at
+ * the end of the heap leaves more than TRIM_MIN bytes beyond one chunk free
+ * there, the excess is given back with a negative sbrk.
+ *
+ * Deferred coalescing:
+ * With the COALESCE_DEFERRED policy heap_free does not coalesce. The block
+ * stays marked allocated and is pushed on the arena's pending list, chained
+ * through its first payload word like a cached block. When DEFER_LIMIT blocks
+ * are pending, or when find_fit misses and the heap would have to grow,
+ * sweep_heap frees them all and rebuilds the free lists and the size tree in
+ * one pass over the heap, merging each run of adjacent free blocks as it
+ * goes. Splits in place and extend_heap still coalesce right away.
+ *
+ * Mapped blocks:
+ * Requests of MMAP_MIN bytes or more do not come from an arena but get a
+ * region of their own from mem_map, so a large buffer neither grows the heap
+ * for good nor leaves a large hole in it once freed. The block's header sits
+ * in the region's second word, so the payload is aligned, and has the MAPPED
+ * bit set, with the size of the whole region. Free unmaps the region. Realloc
+ * resizes a mapped block with mem_remap while it stays at least MMAP_MIN
+ * bytes, and otherwise moves the data between the heap and a region. A
+ * request whose region would not fit the 32-bit header fails with NULL.
  */
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef THREADSAFE
+#include <pthread.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -63,9 +153,33 @@
 #define DSIZE 8 /* Double word size (bytes) */
 #define CHUNKSIZE (1<<8) /* Extend heap by this amount (bytes) */
 
-/* Pack a size and allocated bit into a word */
+/* Adaptive heap extension, see "Heap extension" above */
+#define EXTEND_MAX (1<<16)  /* Largest chunk size (bytes) */
+#define EXTEND_RATIO 4      /* Largest chunk size in average requests */
+#define EXTEND_SHARE 8      /* ... and in fractions of the heap */
+#define GROW_FAST 4         /* Fewer allocations between growths doubles */
+#define GROW_SLOW 256       /* More allocations between growths halves */
+#define TRIM_MIN (1<<14)    /* Smallest free tail (bytes) given back */
+
+/* Deferred coalescing, see "Deferred coalescing" above */
+#define DEFER_LIMIT 256     /* Fewest pending frees that trigger a sweep */
+#define SWEEP_FREE 2        /* ... or this fraction of the heap's blocks */
+#define SWEEP_MISS 16       /* Fraction pending for a find_fit miss to sweep */
+#define PENDING_NEXT(ptr) (*(char **)(ptr))
+
+/* Pack a size and allocated bits into a word */
 #define PACK(size, alloc) ((size) | (alloc))
 
+/* Header bit that is set when the previous block is allocated */
+#define PREV_ALLOC 0x2
+
+/* Header bit of a block in a region of its own, see "Mapped blocks" above */
+#define MAPPED 0x4
+#define MMAP_MIN (1<<17)    /* Smallest request (bytes) that gets a region */
+
+/* Smallest block: header, two free list pointers, and footer */
+#define MIN_BLOCK 24
+
 /* Read and write a word at address p */
 #define GET(p) (*(unsigned int *)(p))
 #define PUT(p, val) (*(unsigned int *)(p) = (val))
@@ -73,12 +187,20 @@
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+#define GET_MAPPED(p) (GET(p) & MAPPED)
+
+/* Set or clear the PREV_ALLOC bit of the header at address p */
+#define SET_PREV_ALLOC(p) PUT(p, GET(p) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(p) PUT(p, GET(p) & ~PREV_ALLOC)
 
-/* Given block ptr ptr, compute address of its header and footer */
+/* Given block ptr ptr, compute address of its header and footer; only free
+ * blocks have a footer */
 #define HDRP(ptr) ((char *)(ptr) - WSIZE)
 #define FTRP(ptr) ((char *)(ptr) + GET_SIZE(HDRP(ptr)) - DSIZE)
 
-/* Given block ptr ptr, compute address of next and previous blocks */
+/* Given block ptr ptr, compute address of next and previous blocks; the
+ * previous block can only be found when it is free */
 #define NEXT_BLKP(ptr) ((char *)(ptr) + GET_SIZE(((char *)(ptr) - WSIZE)))
 #define PREV_BLKP(ptr) ((char *)(ptr) - GET_SIZE(((char *)(ptr) - DSIZE)))
 
@@ -86,58 +208,585 @@
 #define PVFR(ptr) (*(char **)(ptr))
 #define NXFR(ptr) (*((char **)(ptr) + 1))
 
-// pointer to first free block
-char *firstfree;
+/* Free blocks at least this big are kept in the size tree */
+#define TREE_MIN 512
+
+// Tree links and color of a free block in the size tree, after PVFR/NXFR
+#define LEFT(ptr) (*((char **)(ptr) + 2))
+#define RIGHT(ptr) (*((char **)(ptr) + 3))
+#define PARENT(ptr) (*((char **)(ptr) + 4))
+#define COLOR(ptr) (*(unsigned int *)((char **)(ptr) + 5))
+
+#define BLACK 0
+#define RED 1
+#define IS_RED(ptr) ((ptr) != NULL && COLOR(ptr) == RED)
+
+/* Size of the block at block ptr ptr */
+#define BLKSIZE(ptr) GET_SIZE(HDRP(ptr))
+
+#ifdef SEGLIST
+/* Number of size classes; class i holds blocks of size [2^(i+4), 2^(i+5)) */
+#define NUM_CLASSES 20
+#endif
+
+#ifndef NUM_ARENAS
+#define NUM_ARENAS 1    /* Number of independent heaps */
+#endif
+
+#if NUM_ARENAS > 1 && !defined(THREADSAFE)
+#error "multiple arenas only make sense in the THREADSAFE build"
+#endif
+#if NUM_ARENAS > MAX_ARENAS
+#error "memlib cannot model that many arenas"
+#endif
+
+// one independent heap: its free lists, its memlib arena, and its lock
+typedef struct {
+#ifdef SEGLIST
+    // pointers to the first free block of each size class
+    char *seglists[NUM_CLASSES];
+    // bit i is set when seglists[i] is nonempty
+    unsigned int classmap;
+#else
+    // pointer to first free block
+    char *firstfree;
+#endif
+    // root of the size tree of free blocks of at least TREE_MIN bytes
+    char *tree;
+    // blocks freed but not coalesced yet, for COALESCE_DEFERRED
+    char *pending;
+    int npending;
+    int blocks;       /* blocks in the heap at the last sweep */
+    size_t chunksize; /* next heap extension, for EXTEND_ADAPTIVE */
+    size_t avgsize;   /* running average of request sizes */
+    int allocs;       /* heap allocations since the heap last grew */
+    int index;        /* memlib arena this heap grows in */
+    int initialized;  /* prologue and epilogue are in place */
+#ifdef THREADSAFE
+    pthread_mutex_t lock;
+#endif
+} arena_t;
+
+// mapped blocks and the size of their regions
+static size_t mapped_blocks;
+static size_t mapped_bytes;
+
+// how the heap grows, set by mm_set_extend_policy
+static int extend_policy = EXTEND_ADAPTIVE;
+
+// when freed blocks are coalesced, set by mm_set_coalesce_policy; the
+// policy in effect since the last mm_init
+static int coalesce_policy = COALESCE_IMMEDIATE;
+static int coalesce_next = COALESCE_IMMEDIATE;
+
+#ifdef THREADSAFE
+static arena_t arenas[NUM_ARENAS] = {
+    [0 ... NUM_ARENAS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+#else
+static arena_t arenas[NUM_ARENAS];
+#endif
+
+#ifdef THREADSAFE
+#define CACHE_MAX 256   /* Largest block size (bytes) kept in thread caches */
+#define CACHE_BATCH 16  /* Most blocks moved from the heap per refill */
+#define CACHE_LIMIT 64  /* Flush a bin by half once it holds this many */
+#else
+#define CACHE_MAX 128   /* Largest block size (bytes) kept in the cache */
+#define CACHE_BATCH 1   /* Most blocks moved from the heap per refill */
+#define CACHE_LIMIT 32  /* Flush a bin by half once it holds this many */
+#endif
+#define DRAIN_PERIOD 1024  /* Cached frees between drains of every bin */
+
+/* Bin for a block size, and the link stored in a cached block's payload */
+#define CACHE_BIN(size) ((size) / DSIZE)
+#define CACHE_NEXT(ptr) (*(char **)(ptr))
+
+// bins of allocated blocks, one per exact block size
+typedef struct {
+    char *bins[CACHE_BIN(CACHE_MAX) + 1];
+    int counts[CACHE_BIN(CACHE_MAX) + 1];
+    int batch[CACHE_BIN(CACHE_MAX) + 1];  /* next refill, or 0 for one */
+    size_t bytes;    /* total size of the cached blocks */
+    int frees;       /* cached frees since the bins were last drained */
+    int registered;
+} thread_cache;
+
+#ifdef THREADSAFE
+static __thread thread_cache tcache;
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+#define LOCK(a) pthread_mutex_lock(&(a)->lock)
+#define UNLOCK(a) pthread_mutex_unlock(&(a)->lock)
+#else
+static thread_cache tcache;
+
+#define LOCK(a)
+#define UNLOCK(a)
+#endif
+
+// heap_malloc reclaims the cache before it grows the heap
+static int reclaim_cache(thread_cache *tc, arena_t *a);
+
+#if NUM_ARENAS > 1
+// the arena of the calling thread, and the next arena to hand out
+static __thread arena_t *my_arena;
+static int next_arena;
+
+/*
+ * thread_arena
+ * Input: Nothing
+ * Output: The arena the calling thread allocates from
+ * Threads are assigned arenas round-robin on their first allocation
+ */
+static arena_t *thread_arena(void) {
+    if (my_arena == NULL) {
+        my_arena = &arenas[__sync_fetch_and_add(&next_arena, 1) % NUM_ARENAS];
+    }
+    return my_arena;
+}
+
+/*
+ * arena_of
+ * Input: pointer to a block
+ * Output: The arena whose heap holds the block
+ */
+static inline arena_t *arena_of(void *ptr) {
+    return &arenas[mem_arena_of(ptr)];
+}
+#else
+#define thread_arena() (&arenas[0])
+#define arena_of(ptr) (&arenas[0])
+#endif
+
+#ifdef SEGLIST
+/*
+ * size_class
+ * Input: a block size in bytes
+ * Output: the index of the size class that holds blocks of that size
+ * This function computes floor(log2(size)) - 4, capped to the last class
+ */
+static inline int size_class(size_t size) {
+    int class = (63 - __builtin_clzl(size)) - 4;
+
+    if (class >= NUM_CLASSES) {
+        class = NUM_CLASSES - 1;
+    }
+    return class;
+}
+#endif
+
+/*
+ * free_root
+ * Input: an arena and a block size in bytes
+ * Output: a pointer to the root of the arena's free list that holds that size
+ * With a single free list this is always firstfree
+ */
+static inline char **free_root(arena_t *a, size_t size) {
+#ifdef SEGLIST
+    return &a->seglists[size_class(size)];
+#else
+    (void) size;
+    return &a->firstfree;
+#endif
+}
+
+/*
+ * Set_child
+ * Input: an arena, a tree node (NULL for the root), and its old and new child
+ * Output: Nothing
+ * This function points whatever pointed at the old child at the new one
+ */
+static inline void set_child(arena_t *a, char *parent, char *old, char *new) {
+    if (parent == NULL) {
+        a->tree = new;
+    }
+    else if (LEFT(parent) == old) {
+        LEFT(parent) = new;
+    }
+    else {
+        RIGHT(parent) = new;
+    }
+}
+
+/*
+ * Rotate_left
+ * Input: an arena and a tree node with a right child
+ * Output: Nothing
+ * This function makes the node the left child of its right child
+ */
+static void rotate_left(arena_t *a, char *x) {
+    char *y = RIGHT(x);
+
+    RIGHT(x) = LEFT(y);
+    if (LEFT(y)) {
+        PARENT(LEFT(y)) = x;
+    }
+    PARENT(y) = PARENT(x);
+    set_child(a, PARENT(x), x, y);
+    LEFT(y) = x;
+    PARENT(x) = y;
+}
+
+/*
+ * Rotate_right
+ * Input: an arena and a tree node with a left child
+ * Output: Nothing
+ * This function makes the node the right child of its left child
+ */
+static void rotate_right(arena_t *a, char *x) {
+    char *y = LEFT(x);
+
+    LEFT(x) = RIGHT(y);
+    if (RIGHT(y)) {
+        PARENT(RIGHT(y)) = x;
+    }
+    PARENT(y) = PARENT(x);
+    set_child(a, PARENT(x), x, y);
+    RIGHT(y) = x;
+    PARENT(x) = y;
+}
+
+/*
+ * Tree_insert
+ * Input: an arena and a free block of at least TREE_MIN bytes
+ * Output: Nothing
+ * This function adds the block to the size tree, or chains it behind the
+ * node of the same size, and then fixes up the red-black colors
+ */
+static void tree_insert(arena_t *a, char *ptr) {
+    size_t size = BLKSIZE(ptr);
+    char *parent = NULL;
+    char *node = a->tree;
+    char *uncle;
+
+    PVFR(ptr) = NULL;
+    NXFR(ptr) = NULL;
+    while (node) {
+        // same size, so chain it behind the node
+        if (size == BLKSIZE(node)) {
+            PVFR(ptr) = node;
+            NXFR(ptr) = NXFR(node);
+            if (NXFR(node)) {
+                PVFR(NXFR(node)) = ptr;
+            }
+            NXFR(node) = ptr;
+            return;
+        }
+        parent = node;
+        node = (size < BLKSIZE(node)) ? LEFT(node) : RIGHT(node);
+    }
+
+    LEFT(ptr) = NULL;
+    RIGHT(ptr) = NULL;
+    PARENT(ptr) = parent;
+    COLOR(ptr) = RED;
+    if (parent == NULL) {
+        a->tree = ptr;
+    }
+    else if (size < BLKSIZE(parent)) {
+        LEFT(parent) = ptr;
+    }
+    else {
+        RIGHT(parent) = ptr;
+    }
+
+    // a red node may not have a red parent
+    while (IS_RED(PARENT(ptr))) {
+        parent = PARENT(ptr);
+        node = PARENT(parent);
+        if (parent == LEFT(node)) {
+            uncle = RIGHT(node);
+            if (IS_RED(uncle)) {
+                COLOR(parent) = BLACK;
+                COLOR(uncle) = BLACK;
+                COLOR(node) = RED;
+                ptr = node;
+            }
+            else {
+                if (ptr == RIGHT(parent)) {
+                    ptr = parent;
+                    rotate_left(a, ptr);
+                    parent = PARENT(ptr);
+                }
+                COLOR(parent) = BLACK;
+                COLOR(node) = RED;
+                rotate_right(a, node);
+            }
+        }
+        else {
+            uncle = LEFT(node);
+            if (IS_RED(uncle)) {
+                COLOR(parent) = BLACK;
+                COLOR(uncle) = BLACK;
+                COLOR(node) = RED;
+                ptr = node;
+            }
+            else {
+                if (ptr == LEFT(parent)) {
+                    ptr = parent;
+                    rotate_right(a, ptr);
+                    parent = PARENT(ptr);
+                }
+                COLOR(parent) = BLACK;
+                COLOR(node) = RED;
+                rotate_left(a, node);
+            }
+        }
+    }
+    COLOR(a->tree) = BLACK;
+}
+
+/*
+ * Tree_delete_fixup
+ * Input: an arena, the node that took a removed black node's place (maybe
+ * NULL), and its parent
+ * Output: Nothing
+ * This function restores the black height after tree_remove
+ */
+static void tree_delete_fixup(arena_t *a, char *x, char *parent) {
+    char *w;
+
+    while (x != a->tree && !IS_RED(x)) {
+        if (x == LEFT(parent)) {
+            w = RIGHT(parent);
+            if (IS_RED(w)) {
+                COLOR(w) = BLACK;
+                COLOR(parent) = RED;
+                rotate_left(a, parent);
+                w = RIGHT(parent);
+            }
+            if (!IS_RED(LEFT(w)) && !IS_RED(RIGHT(w))) {
+                COLOR(w) = RED;
+                x = parent;
+                parent = PARENT(x);
+            }
+            else {
+                if (!IS_RED(RIGHT(w))) {
+                    COLOR(LEFT(w)) = BLACK;
+                    COLOR(w) = RED;
+                    rotate_right(a, w);
+                    w = RIGHT(parent);
+                }
+                COLOR(w) = COLOR(parent);
+                COLOR(parent) = BLACK;
+                COLOR(RIGHT(w)) = BLACK;
+                rotate_left(a, parent);
+                x = a->tree;
+            }
+        }
+        else {
+            w = LEFT(parent);
+            if (IS_RED(w)) {
+                COLOR(w) = BLACK;
+                COLOR(parent) = RED;
+                rotate_right(a, parent);
+                w = LEFT(parent);
+            }
+            if (!IS_RED(LEFT(w)) && !IS_RED(RIGHT(w))) {
+                COLOR(w) = RED;
+                x = parent;
+                parent = PARENT(x);
+            }
+            else {
+                if (!IS_RED(LEFT(w))) {
+                    COLOR(RIGHT(w)) = BLACK;
+                    COLOR(w) = RED;
+                    rotate_left(a, w);
+                    w = LEFT(parent);
+                }
+                COLOR(w) = COLOR(parent);
+                COLOR(parent) = BLACK;
+                COLOR(LEFT(w)) = BLACK;
+                rotate_right(a, parent);
+                x = a->tree;
+            }
+        }
+    }
+    if (x) {
+        COLOR(x) = BLACK;
+    }
+}
+
+/*
+ * Tree_remove
+ * Input: an arena and a free block in its size tree
+ * Output: Nothing
+ * This function takes the block out of the size tree. A chained block is just
+ * unlinked, and a node with a chain is replaced by the next block of its size.
+ * Only the last block of a size is deleted from the tree and rebalanced.
+ */
+static void tree_remove(arena_t *a, char *ptr) {
+    char *next = NXFR(ptr);
+    char *x, *parent, *y;
+    unsigned int color;
+
+    // chained behind a node
+    if (PVFR(ptr)) {
+        NXFR(PVFR(ptr)) = next;
+        if (next) {
+            PVFR(next) = PVFR(ptr);
+        }
+        return;
+    }
+
+    // the next block of the same size takes the node's place
+    if (next) {
+        PVFR(next) = NULL;
+        LEFT(next) = LEFT(ptr);
+        RIGHT(next) = RIGHT(ptr);
+        PARENT(next) = PARENT(ptr);
+        COLOR(next) = COLOR(ptr);
+        if (LEFT(next)) {
+            PARENT(LEFT(next)) = next;
+        }
+        if (RIGHT(next)) {
+            PARENT(RIGHT(next)) = next;
+        }
+        set_child(a, PARENT(ptr), ptr, next);
+        return;
+    }
+
+    color = COLOR(ptr);
+    // at most one child, so that child moves up
+    if (LEFT(ptr) == NULL || RIGHT(ptr) == NULL) {
+        x = LEFT(ptr) ? LEFT(ptr) : RIGHT(ptr);
+        parent = PARENT(ptr);
+        set_child(a, parent, ptr, x);
+        if (x) {
+            PARENT(x) = parent;
+        }
+    }
+    // two children, so the next larger node moves into its place
+    else {
+        for (y = RIGHT(ptr); LEFT(y); y = LEFT(y)) {
+        }
+        color = COLOR(y);
+        x = RIGHT(y);
+        if (PARENT(y) == ptr) {
+            parent = y;
+        }
+        else {
+            parent = PARENT(y);
+            set_child(a, parent, y, x);
+            if (x) {
+                PARENT(x) = parent;
+            }
+            RIGHT(y) = RIGHT(ptr);
+            PARENT(RIGHT(y)) = y;
+        }
+        set_child(a, PARENT(ptr), ptr, y);
+        PARENT(y) = PARENT(ptr);
+        LEFT(y) = LEFT(ptr);
+        PARENT(LEFT(y)) = y;
+        COLOR(y) = COLOR(ptr);
+    }
+
+    if (color == BLACK) {
+        tree_delete_fixup(a, x, parent);
+    }
+}
+
+/*
+ * Tree_best_fit
+ * Input: an arena and a size in bytes
+ * Output: The smallest free block in the size tree of at least that size, or
+ * NULL. A chained block is preferred, since it is cheaper to remove.
+ */
+static char *tree_best_fit(arena_t *a, size_t size) {
+    char *node = a->tree;
+    char *best = NULL;
+
+    while (node) {
+        if (BLKSIZE(node) == size) {
+            best = node;
+            break;
+        }
+        if (BLKSIZE(node) > size) {
+            best = node;
+            node = LEFT(node);
+        }
+        else {
+            node = RIGHT(node);
+        }
+    }
+
+    if (best && NXFR(best)) {
+        return NXFR(best);
+    }
+    return best;
+}
 
 /*
  * add_free_block
- * Input: pointer to beginning of payload, where the pointer of the previous
- * free block is
+ * Input: an arena, and pointer to beginning of payload, where the pointer of
+ * the previous free block is
  * Output: Nothing
  * This function takes a pointer to a newly free block and adds it to the doubly
  * linked list
  */
-static void add_free_block(char *ptr) {
+static void add_free_block(arena_t *a, char *ptr) {
+    char **root = free_root(a, GET_SIZE(HDRP(ptr)));
+
+    // large blocks go in the size tree
+    if (GET_SIZE(HDRP(ptr)) >= TREE_MIN) {
+        tree_insert(a, ptr);
+        return;
+    }
 
     // no list
-    if (firstfree == NULL) {
-        firstfree = ptr;
-        PVFR(firstfree) = NULL;
-        NXFR(firstfree) = NULL;
+    if (*root == NULL) {
+        *root = ptr;
+        PVFR(ptr) = NULL;
+        NXFR(ptr) = NULL;
+#ifdef SEGLIST
+        a->classmap |= 1u << size_class(GET_SIZE(HDRP(ptr)));
+#endif
     }
 
     // add to beginning of list
     else {
-        PVFR(firstfree) = ptr;
-        NXFR(ptr) = firstfree;
+        PVFR(*root) = ptr;
+        NXFR(ptr) = *root;
         PVFR(ptr) = NULL;
-        firstfree = ptr;
+        *root = ptr;
     }
 }
 
 /*
  * remove_free_block
- * Input: pointer to beginning of payload, where the pointer of the previous
- * free block is
+ * Input: an arena, and pointer to beginning of payload, where the pointer of
+ * the previous free block is
  * Output: Nothing
  * This function takes a pointer to a newly free block and removes it from
- * the doubly linked list
+ * the doubly linked list. The header must still hold the size the block was
+ * added with, since that picks the list.
  */
-static void remove_free_block(char *ptr) {
+static void remove_free_block(arena_t *a, char *ptr) {
+    char **root = free_root(a, GET_SIZE(HDRP(ptr)));
+
+    if (GET_SIZE(HDRP(ptr)) >= TREE_MIN) {
+        tree_remove(a, ptr);
+        return;
+    }
 
     // no list
-    if (!firstfree) {
+    if (!*root) {
         printf("Freeing block that doesn't exist\n");
         exit(1);
     }
     else {
         // only block
         if (!NXFR(ptr) && !PVFR(ptr)) {
-            firstfree = NULL;
+            *root = NULL;
+#ifdef SEGLIST
+            a->classmap &= ~(1u << size_class(GET_SIZE(HDRP(ptr))));
+#endif
         }
         // beginning of list
         else if (NXFR(ptr) && !PVFR(ptr)) {
-            firstfree = NXFR(ptr);
+            *root = NXFR(ptr);
             PVFR(NXFR(ptr)) = NULL;
         }
         // end of list
@@ -154,116 +803,139 @@ static void remove_free_block(char *ptr) {
 
 /*
  * find_fit
- * Input: a size in bytes of type size_t
+ * Input: an arena and a size in bytes of type size_t
  * Output: Either a pointer to a free block or NULL
  * This function iterates through the free list and finds the first block that
- * has enough space given by the input. If no blocks match, return NULL
+ * has enough space given by the input. If no blocks match, return NULL.
+ * With segregated lists only the request's own class needs a search; the
+ * head of any larger nonempty class always fits. Large requests, and small
+ * ones that no list can satisfy, take the best fit from the size tree.
  */
-static void *find_fit(size_t size)
+static void *find_fit(arena_t *a, size_t size)
 {
     // traverse through free list to find fit
     void *ptr;
 
-    for (ptr = firstfree; ptr; ptr = NXFR(ptr)) {
+    if (size >= TREE_MIN) {
+        return tree_best_fit(a, size);
+    }
+
+    for (ptr = *free_root(a, size); ptr; ptr = NXFR(ptr)) {
         if (size <= GET_SIZE(HDRP(ptr))) {
          return ptr;
         }
     }
-    // no fit in search
-    return NULL;
+
+#ifdef SEGLIST
+    // every block in a larger class is big enough, so take the head of the
+    // smallest nonempty one
+    unsigned int larger = a->classmap & ~((2u << size_class(size)) - 1);
+    if (larger) {
+        return a->seglists[__builtin_ctz(larger)];
+    }
+#endif
+
+    // no fit in the lists, so the smallest large block
+    return tree_best_fit(a, size);
 }
 
 /*
  * Coalesce
- * Input: A pointer to a block
+ * Input: An arena and a pointer to a block in it
  * Output: A pointer to a new block
  * This function takes in a block pointer and sees if it can join free blocks
  * by checking if the previous and next blocks are allocated. This also updates
- * the free list by calling add_free_block or remove_free_block
+ * the free list by calling add_free_block or remove_free_block. The block must
+ * already have a free header and footer. Whatever it turns into, the block
+ * after it is told that its previous block is now free.
  */
-static void *coalesce(void *ptr) {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(ptr)));
+static void *coalesce(arena_t *a, void *ptr) {
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(ptr)));
     size_t size = GET_SIZE(HDRP(ptr));
     size_t nextsize = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
-    size_t prevsize = GET_SIZE(HDRP(PREV_BLKP(ptr)));
+    size_t prevsize;
 
     // both prev and next are allocated
     if (prev_alloc && next_alloc) {
-        add_free_block(ptr);
+        add_free_block(a, ptr);
     }
 
     // next is not allocated
     else if (prev_alloc && !next_alloc) {
-        remove_free_block(NEXT_BLKP(ptr));
+        remove_free_block(a, NEXT_BLKP(ptr));
         size += nextsize;
-        PUT(HDRP(ptr), PACK(size, 0));
+        PUT(HDRP(ptr), PACK(size, prev_alloc));
         PUT(FTRP(ptr), PACK(size,0));
-        add_free_block(ptr);
+        add_free_block(a, ptr);
 
     }
 
     // prev is not allocated
     else if (!prev_alloc && next_alloc) {
-        remove_free_block(PREV_BLKP(ptr));
+        prevsize = GET_SIZE(HDRP(PREV_BLKP(ptr)));
+        remove_free_block(a, PREV_BLKP(ptr));
         size += prevsize;
         PUT(FTRP(ptr), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(ptr)), PACK(size, 0));
-        add_free_block(PREV_BLKP(ptr));
         ptr = PREV_BLKP(ptr);
+        PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
+        add_free_block(a, ptr);
     }
 
     // both prev and next are not allocated
     else {
-        remove_free_block(PREV_BLKP(ptr));
-        remove_free_block(NEXT_BLKP(ptr));
+        prevsize = GET_SIZE(HDRP(PREV_BLKP(ptr)));
+        remove_free_block(a, PREV_BLKP(ptr));
+        remove_free_block(a, NEXT_BLKP(ptr));
         size += nextsize + prevsize;
-        PUT(HDRP(PREV_BLKP(ptr)), PACK(size, 0));
         PUT(FTRP(NEXT_BLKP(ptr)), PACK(size, 0));
-        add_free_block(PREV_BLKP(ptr));
         ptr = PREV_BLKP(ptr);
+        PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
+        add_free_block(a, ptr);
     }
+
+    CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
     return ptr;
 }
 
 /*
  * Place
- * Input: A pointer to a block and a size
+ * Input: An arena, a pointer to a free block in it, and a size
  * Output: Nothing
  * This function takes in a pointer and a size and checks if the block has
  * enough space. It acts accordingly given the space in the block.
  */
-static void place(void *ptr, size_t size)
+static void place(arena_t *a, void *ptr, size_t size)
 {
     size_t csize = GET_SIZE(HDRP(ptr));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
 
-    // makes sure there is enough room
+    // makes sure there is enough room for a free block after it
     // 24 = 4 (header) + 4 (footer) + 16 (pointers)
-    if (csize - size > 24) {
-        remove_free_block(ptr);
-        PUT(HDRP(ptr), PACK(size, 1));
-        PUT(FTRP(ptr), PACK(size, 1));
+    if (csize - size >= MIN_BLOCK) {
+        remove_free_block(a, ptr);
+        PUT(HDRP(ptr), PACK(size, 1 | prev_alloc));
         ptr = NEXT_BLKP(ptr);
-        PUT(HDRP(ptr), PACK(csize-size, 0));
+        PUT(HDRP(ptr), PACK(csize-size, PREV_ALLOC));
         PUT(FTRP(ptr), PACK(csize-size, 0));
-        coalesce(ptr);
+        coalesce(a, ptr);
     }
     else {
-        remove_free_block(ptr);
-        PUT(HDRP(ptr), PACK(csize, 1));
-        PUT(FTRP(ptr), PACK(csize, 1));
+        remove_free_block(a, ptr);
+        PUT(HDRP(ptr), PACK(csize, 1 | prev_alloc));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
     }
 }
 
 /*
  * Extend_heap
- * Input: An amount of bytes
+ * Input: An arena and an amount of words
  * Output: Nothing
  * This function takes in an amount of bytes and adds new blocks to the heap.
  * This makes sure that alligment is correct and makes the header and footer
  * for the blocks. It also calls coalesce which adds free blocks to the list
  */
-static void *extend_heap(size_t words) {
+static void *extend_heap(arena_t *a, size_t words) {
     char *ptr;
     size_t size;
 
@@ -276,44 +948,44 @@ static void *extend_heap(size_t words) {
     }
 
     // must be large enough for the header, footer, and pointers
-    if (size < 24) {
-        size = 24;
+    if (size < MIN_BLOCK) {
+        size = MIN_BLOCK;
     }
 
-    if ((long)(ptr = mem_sbrk(size)) == -1) {
+    if ((long)(ptr = mem_arena_sbrk(a->index, size)) == -1) {
         return NULL;
     }
 
-    // Make free block header, footer, and updatew epilogue
-    PUT(HDRP(ptr), PACK(size, 0));
+    // Make free block header, footer, and updatew epilogue. The old epilogue
+    // header becomes the new block's, so it knows if the last block is free.
+    PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
     PUT(FTRP(ptr), PACK(size, 0));
     PUT(HDRP(NEXT_BLKP(ptr)), PACK(0, 1));
 
     // coalesce updated heap
-    return coalesce(ptr);
+    return coalesce(a, ptr);
 }
 
 
 /*
- * Mm_init
- * Input: Nothing
- * Output: Nothing
- * This is the first call which sets up the heap and creates a free block. This
+ * Arena_init
+ * Input: An arena
+ * Output: 0 on success, -1 if the arena could not be grown
+ * This function sets up the arena's heap and creates a free block. This
  * function creates the alignment, prologue, and epilogue.
  */
-int mm_init(void) {
+static int arena_init(arena_t *a) {
 
-    void *heap_listp;
+    char *heap_listp;
     // Create the initial empty heap
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1) {
+    if ((heap_listp = mem_arena_sbrk(a->index, 4*WSIZE)) == (void *)-1) {
         return -1;
     }
 
-    firstfree = NULL;
     PUT(heap_listp, 0); // Alignment
     PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1)); // Prologue header
     PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1)); // Prologue footer
-    PUT(heap_listp + (3*WSIZE), PACK(0, 1)); // Epilogue
+    PUT(heap_listp + (3*WSIZE), PACK(0, 1 | PREV_ALLOC)); // Epilogue
     heap_listp += (2*WSIZE);
 
     // check the epilogue
@@ -324,202 +996,846 @@ int mm_init(void) {
     }
 
     // Extend the empty heap with a free block of CHUNKSIZE bytes
-    if (extend_heap(CHUNKSIZE/WSIZE) == NULL) {
+    if (extend_heap(a, CHUNKSIZE/WSIZE) == NULL) {
         return -1;
     }
 
+    a->initialized = 1;
     return 0;
 }
 
 /*
- * Malloc
- * Input: A size in bytes
- * Output: A pointer to where the data is stored in the heap_list
- * This function takes in a size of bytes, deals with alignment, and finds
- * space in the heap to store these bytes. The function searches through
- * free blocks in find_fit and then extends the heap if need in extend_heap
+ * Mm_init
+ * Input: Nothing
+ * Output: Nothing
+ * This is the first call which empties every arena and sets up the first one.
+ * The other arenas are set up by the first thread that allocates from them.
  */
-void *malloc(size_t size) {
-
-    size_t asize;
-    size_t extendsize;
-    char *ptr;
+int mm_init(void) {
 
-    // no memory to allocate
-    if (size == 0) {
-        return NULL;
+    for (int i = 0; i < NUM_ARENAS; i++) {
+        arena_t *a = &arenas[i];
+#ifdef SEGLIST
+        for (int class = 0; class < NUM_CLASSES; class++) {
+            a->seglists[class] = NULL;
+        }
+        a->classmap = 0;
+#else
+        a->firstfree = NULL;
+#endif
+        a->tree = NULL;
+        a->pending = NULL;
+        a->npending = 0;
+        a->blocks = 0;
+        a->chunksize = CHUNKSIZE;
+        a->avgsize = 0;
+        a->allocs = 0;
+        a->index = i;
+        a->initialized = 0;
     }
+#if NUM_ARENAS > 1
+    my_arena = &arenas[0];
+    next_arena = 1;
+#endif
+    memset(&tcache, 0, sizeof(tcache));
+    coalesce_policy = coalesce_next;
+    mapped_blocks = 0;
+    mapped_bytes = 0;
+
+    return arena_init(&arenas[0]);
+}
 
-    // make sure bigger than content in block
-    if (ALIGN(size) + 8 > 24) {
-      asize = ALIGN(size) + 8;
-    }
-    else {
-      asize = 24;
+/*
+ * Mm_set_extend_policy
+ * Input: EXTEND_FIXED or EXTEND_ADAPTIVE
+ * Output: Nothing
+ * This function picks how the heap grows from the next mm_init on
+ */
+void mm_set_extend_policy(int policy) {
+    extend_policy = policy;
+}
+
+/*
+ * Mm_set_coalesce_policy
+ * Input: COALESCE_IMMEDIATE or COALESCE_DEFERRED
+ * Output: Nothing
+ * This function picks when freed blocks are coalesced from the next mm_init
+ * on, since blocks may be pending under the current policy
+ */
+void mm_set_coalesce_policy(int policy) {
+    coalesce_next = policy;
+}
+
+/*
+ * Tail_size
+ * Input: An arena
+ * Output: The size of the free block at the end of its heap, or 0 if the last
+ * block is allocated
+ */
+static size_t tail_size(arena_t *a) {
+    char *epilogue = (char *)mem_arena_hi(a->index) + 1;
+
+    if (GET_PREV_ALLOC(HDRP(epilogue))) {
+        return 0;
     }
+    return GET_SIZE(HDRP(epilogue) - WSIZE);
+}
 
-    // search free list for spot with right size
-    if ((ptr = find_fit(asize)) != NULL) {
-        place(ptr, asize);
-        return ptr;
+/*
+ * Extend_size
+ * Input: An arena and an adjusted block size in bytes that did not fit
+ * Output: How many bytes to grow the heap by
+ * This function applies the extension policy and adapts the arena's chunk
+ * size to how fast the heap has been growing
+ */
+static size_t extend_size(arena_t *a, size_t asize) {
+    size_t heapsize;
+    size_t limit;
+    size_t need;
+
+    if (extend_policy == EXTEND_FIXED) {
+        return (asize > CHUNKSIZE) ? asize : CHUNKSIZE;
     }
 
-    // search failed so extend the heap with size
-    if (asize > CHUNKSIZE) {
-      extendsize = asize;
+    // growing again soon means more growth is coming, rarely means it stopped,
+    // but a small heap never grows by more than a share of itself
+    limit = ALIGN(EXTEND_RATIO * a->avgsize);
+    if (limit > EXTEND_MAX) {
+        limit = EXTEND_MAX;
     }
-    else {
-      extendsize = CHUNKSIZE;
+    heapsize = (char *)mem_arena_hi(a->index) + 1
+        - (char *)mem_arena_lo(a->index);
+    if (limit > heapsize / EXTEND_SHARE) {
+        limit = heapsize / EXTEND_SHARE;
     }
-
-    if ((ptr = extend_heap(extendsize / WSIZE)) == NULL) {
-        return NULL;
+    if (a->allocs < GROW_FAST && a->chunksize * 2 <= limit) {
+        a->chunksize *= 2;
     }
-    place(ptr, asize);
-    return ptr;
+    else if (a->allocs > GROW_SLOW && a->chunksize > CHUNKSIZE) {
+        a->chunksize /= 2;
+    }
+    a->allocs = 0;
+
+    // the free block at the end already covers part of a request that fits
+    // in a chunk; a larger one gets a block of its own and leaves the tail
+    // for the small requests that follow it
+    need = asize - tail_size(a);
+    return (need > a->chunksize) ? asize : a->chunksize;
 }
 
 /*
- * Free
- * Input: a pointer
+ * Trim_heap
+ * Input: An arena and a free block in it
  * Output: Nothing
- * This function takes in a pointer and removes the memory that was stored at
- * that block. If NULL is inputted, nothing happens
+ * This function gives the end of the heap back when the block is a free tail
+ * that is much larger than the chunk size, keeping one chunk for regrowth
  */
-void free(void *ptr) {
+static void trim_heap(arena_t *a, char *ptr) {
+    size_t size = GET_SIZE(HDRP(ptr));
+    size_t keep = a->chunksize;
 
-    // no effect for NULL
-    if (!ptr) {
+    if (extend_policy == EXTEND_FIXED || GET_SIZE(HDRP(NEXT_BLKP(ptr))) != 0
+        || size < keep + TRIM_MIN) {
         return;
     }
-    else {
-        // get size of block and set to zero
-        size_t size = GET_SIZE(HDRP(ptr));
-        PUT(HDRP(ptr), PACK(size, 0));
+
+    remove_free_block(a, ptr);
+    mem_arena_sbrk(a->index, -(int)(size - keep));
+    PUT(HDRP(ptr), PACK(keep, GET_PREV_ALLOC(HDRP(ptr))));
+    PUT(FTRP(ptr), PACK(keep, 0));
+    PUT(HDRP(NEXT_BLKP(ptr)), PACK(0, 1));
+    add_free_block(a, ptr);
+}
+
+/*
+ * Sweep_heap
+ * Input: An arena
+ * Output: Nothing
+ * This function frees the arena's pending blocks and then rebuilds its free
+ * lists and size tree from scratch in one pass over the heap, merging every
+ * run of adjacent free blocks into one. A large free tail is trimmed.
+ */
+static void sweep_heap(arena_t *a) {
+    char *ptr, *next;
+    char *last = NULL;
+    size_t size;
+    int blocks = 0;
+
+    // free the pending blocks without looking at their neighbours
+    for (ptr = a->pending; ptr; ptr = next) {
+        next = PENDING_NEXT(ptr);
+        size = GET_SIZE(HDRP(ptr));
+        PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
+        PUT(FTRP(ptr), PACK(size, 0));
+        CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+    }
+    a->pending = NULL;
+    a->npending = 0;
+
+    // empty the free lists and the tree
+#ifdef SEGLIST
+    for (int class = 0; class < NUM_CLASSES; class++) {
+        a->seglists[class] = NULL;
+    }
+    a->classmap = 0;
+#else
+    a->firstfree = NULL;
+#endif
+    a->tree = NULL;
+
+    // merge each run of free blocks and list it again
+    for (ptr = (char *)mem_arena_lo(a->index) + 4 * WSIZE;
+         GET_SIZE(HDRP(ptr)) > 0; ptr = NEXT_BLKP(ptr)) {
+        blocks += 1;
+        if (GET_ALLOC(HDRP(ptr))) {
+            continue;
+        }
+        size = GET_SIZE(HDRP(ptr));
+        for (next = ptr + size; !GET_ALLOC(HDRP(next));
+             next += GET_SIZE(HDRP(next))) {
+            size += GET_SIZE(HDRP(next));
+        }
+        PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
         PUT(FTRP(ptr), PACK(size, 0));
-        // this updates the free list
-        coalesce(ptr);
+        add_free_block(a, ptr);
+        last = ptr;
+    }
+
+    a->blocks = blocks;
+    if (last) {
+        trim_heap(a, last);
     }
 }
 
 /*
- * Realloc
- * Input: A pointer to where memory is stored and a size in bytes
- * Output: A pointer to a new place in memory
- * This function takes in existing memory and finds a new place to store it
+ * Heap_malloc
+ * Input: An arena and an adjusted block size in bytes
+ * Output: A pointer to the payload of an allocated block of at least that size
+ * This function searches through free blocks in find_fit and then extends the
+ * heap if need in extend_heap, by as much as extend_size says. In the
+ * thread-safe build the caller must hold the arena's lock.
  */
-void *realloc(void *oldptr, size_t size) {
-    size_t oldsize;
-    void *newptr;
+static void *heap_malloc(arena_t *a, size_t asize) {
 
-    // realloc to nothing so free
-    if (size == 0) {
-        free(oldptr);
+    size_t extendsize;
+    char *ptr;
+
+    // first allocation from this arena
+    if (!a->initialized && arena_init(a) < 0) {
         return NULL;
     }
 
-    // no original data so malloc
-    if (oldptr == NULL) {
-        return malloc(size);
+    // remember the request for the extension policy
+    a->avgsize = (7 * a->avgsize + asize) / 8;
+    a->allocs += 1;
+
+    // search free list for spot with right size
+    if ((ptr = find_fit(a, asize)) != NULL) {
+        place(a, ptr, asize);
+        return ptr;
     }
 
-    // if we cannot allocate, just leave it
-    if((newptr = malloc(size)) == NULL) {
-        return 0;
+    // the caller's cached blocks may coalesce into a fit; other threads'
+    // caches cannot be reached from here
+    if (tcache.bytes > 0 && reclaim_cache(&tcache, a) > 0) {
+        if ((ptr = find_fit(a, asize)) != NULL) {
+            place(a, ptr, asize);
+            return ptr;
+        }
     }
 
-    // copy data to new spot
-    oldsize = *SIZE_PTR(oldptr);
-    if(size < oldsize) oldsize = size;
-    memcpy(newptr, oldptr, oldsize);
+    // so may the pending blocks, if there are enough to pay for a sweep
+    if (a->npending > 0 && a->npending >= a->blocks / SWEEP_MISS) {
+        sweep_heap(a);
+        if ((ptr = find_fit(a, asize)) != NULL) {
+            place(a, ptr, asize);
+            return ptr;
+        }
+    }
 
-    // get rid of old block
-    free(oldptr);
+    // search failed so extend the heap with size
+    extendsize = extend_size(a, asize);
 
-    return newptr;
+    if ((ptr = extend_heap(a, extendsize / WSIZE)) == NULL) {
+        return NULL;
+    }
+    place(a, ptr, asize);
+    return ptr;
 }
 
 /*
- * calloc - Allocate the block and set it to zero.
+ * Heap_free
+ * Input: an arena and a pointer to an allocated block in it
+ * Output: Nothing
+ * This function marks the block free and coalesces it into the free list,
+ * trimming the heap if it ends in a large free block. Under COALESCE_DEFERRED
+ * the block is only put on the pending list. In the thread-safe build the
+ * caller must hold the arena's lock.
  */
-void *calloc (size_t nmemb, size_t size) {
+static void heap_free(arena_t *a, void *ptr) {
+
+    if (coalesce_policy == COALESCE_DEFERRED) {
+        PENDING_NEXT(ptr) = a->pending;
+        a->pending = ptr;
+        a->npending += 1;
+        if (a->npending >= DEFER_LIMIT && a->npending >= a->blocks / SWEEP_FREE) {
+            sweep_heap(a);
+        }
+        return;
+    }
 
-    void *newptr = malloc(nmemb * size);
-    memset(newptr, 0, nmemb * size);
+    // get size of block and set to zero, keeping the PREV_ALLOC bit
+    size_t size = GET_SIZE(HDRP(ptr));
+    PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
+    PUT(FTRP(ptr), PACK(size, 0));
+    // this updates the free list
+    trim_heap(a, coalesce(a, ptr));
+}
 
-    return newptr;
+/*
+ * Shrink_block
+ * Input: An arena, a pointer to an allocated block in it, and a smaller size
+ * Output: Nothing
+ * This function cuts the block down to size and frees the tail, if the tail
+ * is big enough to be a block of its own
+ */
+static void shrink_block(arena_t *a, void *ptr, size_t size) {
+    size_t csize = GET_SIZE(HDRP(ptr));
+
+    if (csize - size >= MIN_BLOCK) {
+        PUT(HDRP(ptr), PACK(size, 1 | GET_PREV_ALLOC(HDRP(ptr))));
+        ptr = NEXT_BLKP(ptr);
+        PUT(HDRP(ptr), PACK(csize-size, PREV_ALLOC));
+        PUT(FTRP(ptr), PACK(csize-size, 0));
+        coalesce(a, ptr);
+    }
 }
 
 /*
- * mm_checkheap:
- * Input: Integer line number
- * Output: Nothing, will exit if an error occurs
- * Function performs checks on the heap and free list
+ * Heap_resize
+ * Input: An arena, a pointer to an allocated block in it, and an adjusted
+ * block size in bytes
+ * Output: The same pointer if the block now has that size, or NULL if it
+ * could not be resized in place
+ * This function shrinks the block by splitting off its tail, or grows it into
+ * the free block after it. When the block is the last one in the heap, the
+ * heap is extended right after it first, by as much as extend_size says once
+ * the chunk has grown, and while it stays last it keeps less than a chunk of
+ * that as slack instead of splitting it off. In the thread-safe build the
+ * caller must hold the arena's lock.
  */
-void mm_checkheap(int lineno) {
+static void *heap_resize(arena_t *a, void *ptr, size_t asize) {
+    size_t csize = GET_SIZE(HDRP(ptr));
+    char *next = NEXT_BLKP(ptr);
+    char *end = next;
+    size_t room = csize;
+    size_t keep = asize;
+    size_t extendsize;
 
-    char *check;
-    int countfreelist = 0;
-    int freeheaplist = 0;
+    // already big enough, so split off the tail; only the last block keeps
+    // the slack its growth left, less than a chunk, for its next growth
+    if (asize <= csize) {
+        if (GET_SIZE(HDRP(next)) != 0 || csize - asize >= a->chunksize) {
+            shrink_block(a, ptr, asize);
+        }
+        return ptr;
+    }
 
-    // check the prologue header
-    if (GET_SIZE(mem_heap_lo() + WSIZE) != DSIZE || GET_ALLOC(mem_heap_lo()\
-     + WSIZE) != 1) {
-        fprintf(stderr, "%d:Prologue header is wrong\n", lineno);
-        exit(1);
+    // the block after the free space next to it, if any
+    if (!GET_ALLOC(HDRP(next))) {
+        room += GET_SIZE(HDRP(next));
+        end = NEXT_BLKP(next);
     }
 
-    // check the prologue footer
-    if (GET_SIZE(mem_heap_lo() + 2 * WSIZE) != DSIZE || GET_ALLOC(mem_heap_lo()\
-     + 2 * WSIZE) != 1) {
-        fprintf(stderr, "%d:Prologue footer is wrong\n", lineno);
-        exit(1);
+    // last block, so grow the heap after it. The growth counts as a request
+    // for the extension policy, and once growth is frequent enough for the
+    // chunk to have grown, the block takes the whole extension, so a
+    // growing buffer does not leave a free tail for small blocks to pin.
+    // extend_size counts the free block next to it as the tail.
+    if (room < asize && GET_SIZE(HDRP(end)) == 0) {
+        a->avgsize = (7 * a->avgsize + asize) / 8;
+        a->allocs += 1;
+        extendsize = extend_size(a, asize - csize);
+        if (a->chunksize == CHUNKSIZE) {
+            extendsize = asize - room;
+        }
+        if (extend_heap(a, extendsize / WSIZE) == NULL) {
+            return NULL;
+        }
+        room = csize + GET_SIZE(HDRP(next));
+        keep = room;
     }
 
-    // check the epilogue
-    if (GET_SIZE(mem_heap_hi() - 3) != 0 || GET_ALLOC(mem_heap_hi() - 3) != 1) {
-        fprintf(stderr, "%d:Epilogue is wrong\n", lineno);
-        exit(1);
+    if (room < asize) {
+        return NULL;
     }
 
+    // take over the free block after it and give back what is left
+    remove_free_block(a, next);
+    PUT(HDRP(ptr), PACK(room, 1 | GET_PREV_ALLOC(HDRP(ptr))));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+    shrink_block(a, ptr, keep);
+    return ptr;
+}
 
-    // checking the heap
-    for (char *ptr = mem_heap_lo() + 4 * WSIZE; GET_SIZE(HDRP(ptr)) > 0;\
-     ptr = NEXT_BLKP(ptr)) {
-        // count number of free blocks
-        if (!GET_ALLOC(HDRP(ptr))) {
-            freeheaplist += 1;
-            // there is a next block
-            if (GET_SIZE(HDRP(NEXT_BLKP(ptr))) > 0) {
-                // the next block is also free
-                if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
-                    fprintf(stderr, "%d:Two free blocks: coalescing failed\n",\
-                     lineno);
-                    exit(1);
-                }
+/*
+ * Flush_cache
+ * Input: A thread cache, a bin, and how many blocks to leave in the bin
+ * Output: Nothing
+ * This function hands cached blocks back to the arenas they came from. The
+ * lock is only switched when the arena changes, so a bin filled from one
+ * arena is flushed under one lock.
+ */
+static void flush_cache(thread_cache *tc, int bin, int keep) {
+    arena_t *held = NULL;
+    arena_t *a;
+    char *ptr;
+
+    while (tc->counts[bin] > keep) {
+        ptr = tc->bins[bin];
+        tc->bins[bin] = CACHE_NEXT(ptr);
+        tc->counts[bin] -= 1;
+        tc->bytes -= GET_SIZE(HDRP(ptr));
+
+        a = arena_of(ptr);
+        if (a != held) {
+            if (held) {
+                UNLOCK(held);
             }
+            LOCK(a);
+            held = a;
+        }
+        heap_free(a, ptr);
+    }
+    if (held) {
+        UNLOCK(held);
+    }
+}
 
-            if ((size_t)ptr % 8) {
-                fprintf(stderr, "%d:Allignment off\n", lineno);
-                exit(1);
+/*
+ * Drain_cache
+ * Input: A thread cache
+ * Output: Nothing
+ * This function hands every cached block back to the heap, where it is
+ * coalesced with its free neighbours
+ */
+static void drain_cache(thread_cache *tc) {
+    for (int bin = 0; bin <= CACHE_BIN(CACHE_MAX); bin++) {
+        if (tc->counts[bin] > 0) {
+            flush_cache(tc, bin, 0);
+        }
+    }
+    tc->frees = 0;
+}
+
+/*
+ * Reclaim_cache
+ * Input: A thread cache and an arena whose lock the caller holds
+ * Output: The number of blocks handed back
+ * This function frees the cached blocks that belong to the arena, so that
+ * they can coalesce before the arena grows, and drops the bins' batches back
+ * to one block since the heap is short of space
+ */
+static int reclaim_cache(thread_cache *tc, arena_t *a) {
+    int reclaimed = 0;
+    char **link;
+    char *ptr;
+
+    for (int bin = 0; bin <= CACHE_BIN(CACHE_MAX); bin++) {
+        link = &tc->bins[bin];
+        while ((ptr = *link) != NULL) {
+            if (arena_of(ptr) != a) {
+                link = &CACHE_NEXT(ptr);
+                continue;
             }
+            *link = CACHE_NEXT(ptr);
+            tc->counts[bin] -= 1;
+            tc->bytes -= GET_SIZE(HDRP(ptr));
+            heap_free(a, ptr);
+            reclaimed++;
+        }
+        tc->batch[bin] = 0;
+    }
+    return reclaimed;
+}
+
+#ifdef THREADSAFE
+/*
+ * Release_cache
+ * Input: The exiting thread's cache
+ * Output: Nothing
+ * This is the destructor of cache_key, so an exiting thread's cached blocks
+ * go back to the heap instead of leaking
+ */
+static void release_cache(void *arg) {
+    drain_cache(arg);
+}
+
+/*
+ * Make_cache_key
+ * Input: Nothing
+ * Output: Nothing
+ * This function runs once to create the key that flushes caches on exit
+ */
+static void make_cache_key(void) {
+    pthread_key_create(&cache_key, release_cache);
+}
+#endif
+
+/*
+ * Refill_cache
+ * Input: A thread cache and an adjusted block size
+ * Output: A block of that size for the caller, or NULL
+ * This function takes the bin's batch of blocks from the thread's arena under
+ * one lock, and doubles the batch for the next miss up to CACHE_BATCH.
+ * The first block is returned and the rest go into the bin. The rest only
+ * come from free blocks, so a refill never grows the heap for blocks that
+ * may not be used, and if place hands out a block larger than asize, the
+ * batch stops so the bin stays exact.
+ */
+static void *refill_cache(thread_cache *tc, size_t asize) {
+    arena_t *a = thread_arena();
+    int bin = CACHE_BIN(asize);
+    int batch = tc->batch[bin] ? tc->batch[bin] : 1;
+    char *result;
+    char *ptr;
+
+    if (batch * 2 <= CACHE_BATCH) {
+        tc->batch[bin] = batch * 2;
+    }
 
+    LOCK(a);
+    result = heap_malloc(a, asize);
+    for (int i = 1; result && i < batch; i++) {
+        if ((ptr = find_fit(a, asize)) == NULL) {
+            break;
+        }
+        place(a, ptr, asize);
+        if (GET_SIZE(HDRP(ptr)) != asize) {
+            heap_free(a, ptr);
+            break;
         }
+        CACHE_NEXT(ptr) = tc->bins[bin];
+        tc->bins[bin] = ptr;
+        tc->counts[bin] += 1;
+        tc->bytes += asize;
+    }
+    UNLOCK(a);
+    return result;
+}
 
-        if (GET_SIZE(HDRP(ptr)) != GET_SIZE(FTRP(ptr)) || GET_ALLOC(HDRP(ptr)) \
-        != GET_ALLOC(FTRP(ptr))) {
-            fprintf(stderr, "%d:Headers and footers not consistent\n", lineno);
-            exit(1);
+/*
+ * Cache_malloc
+ * Input: An adjusted block size of at most CACHE_MAX bytes
+ * Output: A pointer to an allocated block, or NULL
+ * This function pops a block from the thread's bin, refilling it on a miss
+ */
+static void *cache_malloc(size_t asize) {
+    thread_cache *tc = &tcache;
+    int bin = CACHE_BIN(asize);
+    char *ptr;
+
+#ifdef THREADSAFE
+    // register the cache so it gets flushed when this thread exits
+    if (!tc->registered) {
+        pthread_once(&cache_once, make_cache_key);
+        pthread_setspecific(cache_key, tc);
+        tc->registered = 1;
+    }
+#endif
+
+    if ((ptr = tc->bins[bin]) == NULL) {
+        return refill_cache(tc, asize);
+    }
+    tc->bins[bin] = CACHE_NEXT(ptr);
+    tc->counts[bin] -= 1;
+    tc->bytes -= asize;
+    return ptr;
+}
+
+/*
+ * Cache_free
+ * Input: A pointer to an allocated block of at most CACHE_MAX bytes
+ * Output: Nothing
+ * This function pushes the block onto the thread's bin, which stays marked
+ * allocated in the heap, and flushes the bin once it gets too long. Every
+ * DRAIN_PERIOD cached frees all bins are drained, so blocks of sizes that
+ * are no longer asked for get coalesced again.
+ */
+static void cache_free(void *ptr) {
+    thread_cache *tc = &tcache;
+    int bin = CACHE_BIN(GET_SIZE(HDRP(ptr)));
+
+    CACHE_NEXT(ptr) = tc->bins[bin];
+    tc->bins[bin] = ptr;
+    tc->counts[bin] += 1;
+    tc->bytes += GET_SIZE(HDRP(ptr));
+
+    if (++tc->frees >= DRAIN_PERIOD) {
+        drain_cache(tc);
+    }
+    else if (tc->counts[bin] >= CACHE_LIMIT) {
+        flush_cache(tc, bin, CACHE_LIMIT / 2);
+        tc->batch[bin] /= 2;
+    }
+}
+
+/*
+ * Adjust_size
+ * Input: A requested size in bytes
+ * Output: The size of the block that holds it
+ */
+static inline size_t adjust_size(size_t size) {
+
+    // make sure bigger than content in block; allocated blocks only need
+    // a header, but must be able to hold a free block once freed
+    if (ALIGN(size + WSIZE) > MIN_BLOCK) {
+      return ALIGN(size + WSIZE);
+    }
+    else {
+      return MIN_BLOCK;
+    }
+}
+
+/*
+ * Map_size
+ * Input: A requested size
+ * Output: The size of a region that holds it with its header, in whole
+ * pages, or 0 if that size would not fit in the block header
+ */
+static inline size_t map_size(size_t size) {
+    size_t pagesize = mem_pagesize();
+    size_t maxsize = (size_t)UINT_MAX & ~(pagesize - 1);
+
+    // checked before adding, so a size near SIZE_MAX cannot wrap around
+    if (size > maxsize - DSIZE) {
+        return 0;
+    }
+    return (size + DSIZE + pagesize - 1) & ~(pagesize - 1);
+}
+
+/*
+ * Map_block
+ * Input: A requested size of at least MMAP_MIN bytes
+ * Output: A pointer to the payload of a mapped block that holds it, or NULL
+ */
+static void *map_block(size_t size) {
+    size_t mapsize = map_size(size);
+    char *region;
+
+    if (mapsize == 0 || (region = mem_map(mapsize)) == NULL) {
+        return NULL;
+    }
+    PUT(region + WSIZE, PACK(mapsize, 1 | MAPPED));
+    __sync_fetch_and_add(&mapped_blocks, 1);
+    __sync_fetch_and_add(&mapped_bytes, mapsize);
+    return region + DSIZE;
+}
+
+/*
+ * Unmap_block
+ * Input: A pointer to a mapped block
+ * Output: Nothing
+ * This function gives the block's region back
+ */
+static void unmap_block(void *ptr) {
+    __sync_fetch_and_sub(&mapped_blocks, 1);
+    __sync_fetch_and_sub(&mapped_bytes, GET_SIZE(HDRP(ptr)));
+    mem_unmap((char *)ptr - DSIZE);
+}
+
+/*
+ * Remap_block
+ * Input: A pointer to a mapped block and a requested size of at least
+ * MMAP_MIN bytes
+ * Output: A pointer to the block, which may have moved, or NULL if it could
+ * not be resized
+ */
+static void *remap_block(void *ptr, size_t size) {
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    size_t mapsize = map_size(size);
+    char *region;
+
+    if (mapsize == 0) {
+        return NULL;
+    }
+    if (mapsize == oldsize) {
+        return ptr;
+    }
+    if ((region = mem_remap((char *)ptr - DSIZE, mapsize)) == NULL) {
+        return NULL;
+    }
+    PUT(region + WSIZE, PACK(mapsize, 1 | MAPPED));
+    __sync_fetch_and_add(&mapped_bytes, mapsize - oldsize);
+    return region + DSIZE;
+}
+
+/*
+ * Malloc
+ * Input: A size in bytes
+ * Output: A pointer to where the data is stored in the heap_list
+ * This function takes in a size of bytes, deals with alignment, and finds
+ * space in the heap to store these bytes. Small sizes come from the cache,
+ * huge ones from a region of their own, everything else from heap_malloc.
+ */
+void *malloc(size_t size) {
+
+    arena_t *a;
+    size_t asize;
+    char *ptr;
+
+    // no memory to allocate
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size >= MMAP_MIN) {
+        return map_block(size);
+    }
+
+    asize = adjust_size(size);
+
+    if (asize <= CACHE_MAX) {
+        return cache_malloc(asize);
+    }
+
+    a = thread_arena();
+    LOCK(a);
+    ptr = heap_malloc(a, asize);
+    UNLOCK(a);
+    return ptr;
+}
+
+/*
+ * Free
+ * Input: a pointer
+ * Output: Nothing
+ * This function takes in a pointer and removes the memory that was stored at
+ * that block. If NULL is inputted, nothing happens
+ */
+void free(void *ptr) {
+
+    // no effect for NULL
+    if (!ptr) {
+        return;
+    }
+
+    if (GET_MAPPED(HDRP(ptr))) {
+        unmap_block(ptr);
+        return;
+    }
+
+    if (GET_SIZE(HDRP(ptr)) <= CACHE_MAX) {
+        cache_free(ptr);
+        return;
+    }
+
+    arena_t *a = arena_of(ptr);
+    LOCK(a);
+    heap_free(a, ptr);
+    UNLOCK(a);
+}
+
+/*
+ * Realloc
+ * Input: A pointer to where memory is stored and a size in bytes
+ * Output: A pointer to a new place in memory
+ * This function resizes the block in place when it can, see heap_resize, or
+ * remaps a mapped block that stays huge, and otherwise takes in existing
+ * memory and finds a new place to store it
+ */
+void *realloc(void *oldptr, size_t size) {
+    arena_t *a;
+    size_t oldsize;
+    void *newptr;
+
+    // realloc to nothing so free
+    if (size == 0) {
+        free(oldptr);
+        return NULL;
+    }
+
+    // no original data so malloc
+    if (oldptr == NULL) {
+        return malloc(size);
+    }
+
+    // a huge block stays in a region of its own
+    if (GET_MAPPED(HDRP(oldptr))) {
+        if (size >= MMAP_MIN) {
+            return remap_block(oldptr, size);
+        }
+    }
+    // and a heap block stays in the heap if it can
+    else if (size < MMAP_MIN) {
+        a = arena_of(oldptr);
+        LOCK(a);
+        newptr = heap_resize(a, oldptr, adjust_size(size));
+        UNLOCK(a);
+        if (newptr != NULL) {
+            return newptr;
         }
     }
 
-    // checking the free list
-    for (check = firstfree; check != NULL; check = NXFR(check)) {
+    // if we cannot allocate, just leave it
+    if((newptr = malloc(size)) == NULL) {
+        return 0;
+    }
+
+    // copy data to new spot
+    if (GET_MAPPED(HDRP(oldptr))) {
+        oldsize = GET_SIZE(HDRP(oldptr)) - DSIZE;
+    }
+    else {
+        oldsize = GET_SIZE(HDRP(oldptr)) - WSIZE;
+    }
+    if(size < oldsize) oldsize = size;
+    memcpy(newptr, oldptr, oldsize);
+
+    // get rid of the old block; it is not likely to be asked for again
+    // soon, so it skips the cache and coalesces right away
+    if (GET_MAPPED(HDRP(oldptr))) {
+        unmap_block(oldptr);
+    }
+    else {
+        a = arena_of(oldptr);
+        LOCK(a);
+        heap_free(a, oldptr);
+        UNLOCK(a);
+    }
+
+    return newptr;
+}
+
+/*
+ * calloc - Allocate the block and set it to zero.
+ */
+void *calloc (size_t nmemb, size_t size) {
+
+    void *newptr = malloc(nmemb * size);
+    memset(newptr, 0, nmemb * size);
+
+    return newptr;
+}
+
+/*
+ * check_free_list:
+ * Input: the first block of a free list, the bounds of its arena, and an
+ * integer line number
+ * Output: The number of blocks in the list, will exit if an error occurs
+ * Function checks the pointers of one free list for consistency
+ */
+static int check_free_list(char *first, char *lo, char *hi, int lineno) {
+
+    char *check;
+    int countfreelist = 0;
+
+    for (check = first; check != NULL; check = NXFR(check)) {
 
         countfreelist += 1;
 
         // beginning of list so just check next, since prev is NULL
-        if (check == firstfree) {
+        if (check == first) {
 
             // only block in list
             if (NXFR(check) == NULL) {
@@ -533,8 +1849,8 @@ void mm_checkheap(int lineno) {
             }
 
             // make sure pointers are between low and high
-            if ((void *)NXFR(check) > mem_heap_hi() || (void *)NXFR(check)\
-             < mem_heap_lo()) {
+            if (NXFR(check) > hi || NXFR(check)\
+             < lo) {
                 fprintf(stderr, "%d:Pointers out of bounds1\n", lineno);
                 exit(1);
             }
@@ -550,8 +1866,8 @@ void mm_checkheap(int lineno) {
             }
 
             // make sure pointers are between low and high
-            if ((void *)PVFR(check) > mem_heap_hi() || (void *)PVFR(check) \
-            < mem_heap_lo()) {
+            if (PVFR(check) > hi || PVFR(check) \
+            < lo) {
                 fprintf(stderr, "%d:Pointers out of bounds2\n", lineno);
                 exit(1);
             }
@@ -567,16 +1883,199 @@ void mm_checkheap(int lineno) {
             }
 
             // make sure pointers are between low and high
-            if ((void *)NXFR(check) > mem_heap_hi() || (void *)NXFR(check) \
-            < mem_heap_lo()
-                || (void *)PVFR(check) > mem_heap_hi() || (void *)PVFR(check) \
-                < mem_heap_lo()) {
+            if (NXFR(check) > hi || NXFR(check) \
+            < lo
+                || PVFR(check) > hi || PVFR(check) \
+                < lo) {
                 fprintf(stderr, "%d:Pointers out of bounds3\n", lineno);
                 exit(1);
             }
         }
     }
 
+    return countfreelist;
+}
+
+/*
+ * check_tree:
+ * Input: a subtree of the size tree, its parent, the bounds of its arena, the
+ * exclusive size bounds of the subtree (0 for none), a place for its black
+ * height, and an integer line number
+ * Output: The number of blocks in the subtree and their chains, will exit if
+ * an error occurs
+ * Function checks the links, order, and red-black colors of the size tree
+ */
+static int check_tree(char *node, char *parent, char *lo, char *hi,\
+ size_t min, size_t max, int *black, int lineno) {
+
+    int count = 1;
+    int leftblack, rightblack;
+
+    if (node == NULL) {
+        *black = 1;
+        return 0;
+    }
+
+    if (node < lo || node > hi || PARENT(node) != parent || PVFR(node)) {
+        fprintf(stderr, "%d:Size tree pointers not consistent\n", lineno);
+        exit(1);
+    }
+
+    if (BLKSIZE(node) < TREE_MIN || BLKSIZE(node) <= min ||\
+     (max && BLKSIZE(node) >= max)) {
+        fprintf(stderr, "%d:Size tree out of order\n", lineno);
+        exit(1);
+    }
+
+    if (IS_RED(node) && (IS_RED(LEFT(node)) || IS_RED(RIGHT(node)))) {
+        fprintf(stderr, "%d:Red node with a red child\n", lineno);
+        exit(1);
+    }
+
+    // blocks chained behind the node
+    for (char *check = NXFR(node); check; check = NXFR(check)) {
+        count += 1;
+        if (BLKSIZE(check) != BLKSIZE(node) || NXFR(PVFR(check)) != check) {
+            fprintf(stderr, "%d:Size tree chain not consistent\n", lineno);
+            exit(1);
+        }
+    }
+
+    count += check_tree(LEFT(node), node, lo, hi, min, BLKSIZE(node),\
+     &leftblack, lineno);
+    count += check_tree(RIGHT(node), node, lo, hi, BLKSIZE(node), max,\
+     &rightblack, lineno);
+    if (leftblack != rightblack) {
+        fprintf(stderr, "%d:Size tree black heights differ\n", lineno);
+        exit(1);
+    }
+    *black = leftblack + !IS_RED(node);
+
+    return count;
+}
+
+/*
+ * check_arena:
+ * Input: An arena and an integer line number
+ * Output: Nothing, will exit if an error occurs
+ * Function performs checks on the arena's heap and free lists
+ */
+static void check_arena(arena_t *a, int lineno) {
+
+    char *lo = mem_arena_lo(a->index);
+    char *hi = mem_arena_hi(a->index);
+    int countfreelist = 0;
+    int freeheaplist = 0;
+    int countpending = 0;
+    int prev_alloc = 1;
+    int black;
+    char *ptr;
+
+    // check the prologue header
+    if (GET_SIZE(lo + WSIZE) != DSIZE || GET_ALLOC(lo\
+     + WSIZE) != 1) {
+        fprintf(stderr, "%d:Prologue header is wrong\n", lineno);
+        exit(1);
+    }
+
+    // check the prologue footer
+    if (GET_SIZE(lo + 2 * WSIZE) != DSIZE || GET_ALLOC(lo\
+     + 2 * WSIZE) != 1) {
+        fprintf(stderr, "%d:Prologue footer is wrong\n", lineno);
+        exit(1);
+    }
+
+    // check the epilogue
+    if (GET_SIZE(hi - 3) != 0 || GET_ALLOC(hi - 3) != 1) {
+        fprintf(stderr, "%d:Epilogue is wrong\n", lineno);
+        exit(1);
+    }
+
+
+    // checking the heap
+    for (ptr = lo + 4 * WSIZE; GET_SIZE(HDRP(ptr)) > 0;\
+     ptr = NEXT_BLKP(ptr)) {
+        // the PREV_ALLOC bit must match the block before
+        if (!GET_PREV_ALLOC(HDRP(ptr)) != !prev_alloc) {
+            fprintf(stderr, "%d:Previous allocated bit is wrong\n", lineno);
+            exit(1);
+        }
+        prev_alloc = GET_ALLOC(HDRP(ptr));
+
+        // count number of free blocks
+        if (!GET_ALLOC(HDRP(ptr))) {
+            freeheaplist += 1;
+            // there is a next block
+            if (GET_SIZE(HDRP(NEXT_BLKP(ptr))) > 0) {
+                // the next block is also free
+                if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
+                    fprintf(stderr, "%d:Two free blocks: coalescing failed\n",\
+                     lineno);
+                    exit(1);
+                }
+            }
+
+            if ((size_t)ptr % 8) {
+                fprintf(stderr, "%d:Allignment off\n", lineno);
+                exit(1);
+            }
+
+            // only free blocks have footers
+            if (GET_SIZE(HDRP(ptr)) != GET_SIZE(FTRP(ptr)) || \
+            GET_ALLOC(FTRP(ptr))) {
+                fprintf(stderr, "%d:Headers and footers not consistent\n",\
+                 lineno);
+                exit(1);
+            }
+        }
+    }
+
+    // the epilogue must know about the last block too
+    if (!GET_PREV_ALLOC(HDRP(ptr)) != !prev_alloc) {
+        fprintf(stderr, "%d:Epilogue previous allocated bit is wrong\n",\
+         lineno);
+        exit(1);
+    }
+
+    // checking the free list
+#ifdef SEGLIST
+    for (int class = 0; class < NUM_CLASSES; class++) {
+        for (char *check = a->seglists[class]; check; check = NXFR(check)) {
+            // make sure each block is in the list for its size
+            if (size_class(GET_SIZE(HDRP(check))) != class) {
+                fprintf(stderr, "%d:Free block in wrong size class\n",\
+                 lineno);
+                exit(1);
+            }
+        }
+        countfreelist += check_free_list(a->seglists[class], lo, hi,\
+         lineno);
+    }
+#else
+    countfreelist += check_free_list(a->firstfree, lo, hi, lineno);
+#endif
+
+    // checking the size tree
+    if (IS_RED(a->tree)) {
+        fprintf(stderr, "%d:Size tree root is red\n", lineno);
+        exit(1);
+    }
+    countfreelist += check_tree(a->tree, NULL, lo, hi, 0, 0, &black, lineno);
+
+
+    // pending blocks stay marked allocated until the next sweep
+    for (char *check = a->pending; check; check = PENDING_NEXT(check)) {
+        if (check < lo || check > hi || !GET_ALLOC(HDRP(check))) {
+            fprintf(stderr, "%d:Pending block is not an allocated block\n",\
+             lineno);
+            exit(1);
+        }
+        countpending += 1;
+    }
+    if (countpending != a->npending) {
+        fprintf(stderr, "%d:Pending count is wrong\n", lineno);
+        exit(1);
+    }
 
     // check count of freelist and free blocks in heap
     if (countfreelist != freeheaplist) {
@@ -587,3 +2086,118 @@ void mm_checkheap(int lineno) {
 
     // All tests pass
 }
+
+/*
+ * mm_checkheap:
+ * Input: Integer line number
+ * Output: Nothing, will exit if an error occurs
+ * Function performs checks on the heap and free list of every arena in use
+ */
+void mm_checkheap(int lineno) {
+
+    for (int i = 0; i < NUM_ARENAS; i++) {
+        arena_t *a = &arenas[i];
+
+        LOCK(a);
+        if (a->initialized) {
+            check_arena(a, lineno);
+        }
+        UNLOCK(a);
+    }
+}
+
+/*
+ * count_tree:
+ * Input: A node of a size tree
+ * Output: The number of free blocks in its subtree, chains included
+ */
+static size_t count_tree(char *node) {
+    size_t count = 0;
+
+    if (node == NULL) {
+        return 0;
+    }
+    for (char *chain = node; chain; chain = NXFR(chain)) {
+        count += 1;
+    }
+    return count + count_tree(LEFT(node)) + count_tree(RIGHT(node));
+}
+
+/*
+ * mm_heapstats:
+ * Input: The stats to fill in
+ * Output: Nothing
+ * Function walks the heap and the free lists of every arena in use and
+ * reports where the heap's bytes are. Cached and pending blocks are marked
+ * allocated in the heap but are not counted as held by the program; in the
+ * thread-safe build only the caller's cache is known.
+ */
+void mm_heapstats(mm_heapstats_t *stats) {
+    thread_cache *tc = &tcache;
+    size_t size;
+    char *ptr;
+    int class;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < NUM_ARENAS; i++) {
+        arena_t *a = &arenas[i];
+
+        LOCK(a);
+        if (!a->initialized) {
+            UNLOCK(a);
+            continue;
+        }
+        stats->heap_bytes += (char *)mem_arena_hi(a->index) + 1 -
+            (char *)mem_arena_lo(a->index);
+
+        // every block in the heap
+        for (ptr = (char *)mem_arena_lo(a->index) + 4 * WSIZE;
+             GET_SIZE(HDRP(ptr)) > 0; ptr = NEXT_BLKP(ptr)) {
+            size = GET_SIZE(HDRP(ptr));
+            if (GET_ALLOC(HDRP(ptr))) {
+                stats->alloc_blocks += 1;
+                stats->alloc_bytes += size;
+                continue;
+            }
+            stats->free_blocks += 1;
+            stats->free_bytes += size;
+            if (size > stats->largest_free) {
+                stats->largest_free = size;
+            }
+            for (class = 0; class < MM_HIST_CLASSES - 1 &&
+                 ((size_t)2 << class) <= size; class++) {
+            }
+            stats->free_hist[class] += 1;
+        }
+
+        // the free lists and the tree
+#ifdef SEGLIST
+        for (class = 0; class < NUM_CLASSES; class++) {
+            for (ptr = a->seglists[class]; ptr; ptr = NXFR(ptr)) {
+                stats->list_blocks += 1;
+            }
+        }
+#else
+        for (ptr = a->firstfree; ptr; ptr = NXFR(ptr)) {
+            stats->list_blocks += 1;
+        }
+#endif
+        stats->tree_blocks += count_tree(a->tree);
+
+        // blocks that look allocated but are not the program's
+        for (ptr = a->pending; ptr; ptr = PENDING_NEXT(ptr)) {
+            stats->pending_blocks += 1;
+            stats->pending_bytes += GET_SIZE(HDRP(ptr));
+        }
+        UNLOCK(a);
+    }
+
+    for (int bin = 0; bin <= CACHE_BIN(CACHE_MAX); bin++) {
+        stats->cached_blocks += tc->counts[bin];
+    }
+    stats->cached_bytes = tc->bytes;
+    stats->mapped_blocks = mapped_blocks;
+    stats->mapped_bytes = mapped_bytes;
+    stats->alloc_blocks -= stats->cached_blocks + stats->pending_blocks;
+    stats->alloc_bytes -= stats->cached_bytes + stats->pending_bytes;
+}
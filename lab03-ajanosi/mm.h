@@ -20,6 +20,38 @@ extern void *calloc (size_t nmemb, size_t size);
 
 extern int mm_init(void);
 
+/* How mm.c grows its heap; takes effect at the next mm_init */
+#define EXTEND_FIXED 0      /* by CHUNKSIZE, or the request if larger */
+#define EXTEND_ADAPTIVE 1   /* by a chunk that adapts to the growth rate */
+extern void mm_set_extend_policy(int policy);
+
+/* When mm.c merges freed blocks with their neighbours; takes effect at the
+   next mm_init */
+#define COALESCE_IMMEDIATE 0  /* in every free */
+#define COALESCE_DEFERRED 1   /* in a sweep of the heap, now and then */
+extern void mm_set_coalesce_policy(int policy);
+
+/* What a walk of the heap found, filled in by mm_heapstats */
+#define MM_HIST_CLASSES 32
+typedef struct {
+    size_t heap_bytes;      /* size of the heap, all arenas, no regions */
+    size_t alloc_blocks;    /* heap blocks the program holds */
+    size_t alloc_bytes;     /* their size, headers included */
+    size_t free_blocks;     /* free blocks in the heap */
+    size_t free_bytes;
+    size_t largest_free;    /* size of the largest free block */
+    size_t list_blocks;     /* free blocks in the free lists ... */
+    size_t tree_blocks;     /* ... and in the size tree */
+    size_t cached_blocks;   /* blocks in the caller's small-block cache */
+    size_t cached_bytes;
+    size_t pending_blocks;  /* blocks waiting for a deferred sweep */
+    size_t pending_bytes;
+    size_t mapped_blocks;   /* blocks in regions of their own */
+    size_t mapped_bytes;    /* size of those regions */
+    size_t free_hist[MM_HIST_CLASSES]; /* free blocks of [2^i, 2^(i+1)) bytes */
+} mm_heapstats_t;
+extern void mm_heapstats(mm_heapstats_t *stats);
+
 /* This is largely for debugging.  You can do what you want with the
    verbose flag; we don't care. */
 extern void mm_checkheap(int verbose);
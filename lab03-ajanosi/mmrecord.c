@@ -0,0 +1,225 @@
+/*
+ * mmrecord.c - LD_PRELOAD library that records the malloc, free, realloc
+ *     and calloc calls of a program into a binary trace (see mmtrace.h)
+ *     that mdriver can replay against mm.c:
+ *
+ *     unix> make mmrecord.so
+ *     unix> MMRECORD_FILE=ls.mmt LD_PRELOAD=./mmrecord.so ls -l
+ *     unix> ./mdriver -f ls.mmt
+ *
+ * The calls are served by the libc allocator underneath, not by the
+ * interposition build of mm.c (mm.h without DRIVER): that build has no
+ * way to set up its heap before the program's first malloc, so the trace
+ * is taken from libc and replayed against mm.c by mdriver instead.
+ *
+ * Each call and its record are made under one lock, so the trace holds
+ * the calls in the order the allocator saw them even when threads race
+ * to reuse a block; this serializes the program's allocations while it
+ * is recorded. Records are buffered and written with write(2) when the
+ * buffer fills and when the program exits, so recording never allocates.
+ * Allocations made before the library is initialized, and by children
+ * after a fork, are not recorded; mdriver skips frees of blocks it has
+ * not seen allocated.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mmtrace.h"
+
+#define DEFAULT_FILE "mmtrace.mmt"  /* trace file if MMRECORD_FILE is unset */
+#define BUF_RECS 4096               /* records buffered between writes */
+
+/* The libc allocator that does the real work */
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+
+/* private variables */
+static int trace_fd = -1;                /* -1 while not recording */
+static uint64_t start_ns;                /* time recording started */
+static mmtrace_rec_t buf[BUF_RECS];      /* records not written yet */
+static int buf_recs;
+static pthread_mutex_t buf_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t my_tid;         /* cached gettid() */
+
+/*
+ * now_ns - monotonic time in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * write_all - write len bytes to the trace file, stopping the recording
+ *     if the file cannot take them
+ */
+static void write_all(const void *data, size_t len)
+{
+	const char *p = data;
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(trace_fd, p, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			close(trace_fd);
+			trace_fd = -1;
+			return;
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+/*
+ * flush_buf - write out the buffered records; called with buf_lock held
+ */
+static void flush_buf(void)
+{
+	if (trace_fd >= 0 && buf_recs > 0)
+		write_all(buf, buf_recs * sizeof(mmtrace_rec_t));
+	buf_recs = 0;
+}
+
+/*
+ * lock_trace - take buf_lock for a call that is to be recorded; returns
+ *     0, without the lock, when nothing is being recorded
+ */
+static int lock_trace(void)
+{
+	if (trace_fd < 0)
+		return 0;
+	if (my_tid == 0)
+		my_tid = (uint32_t)syscall(SYS_gettid);
+
+	pthread_mutex_lock(&buf_lock);
+	if (trace_fd < 0) {
+		pthread_mutex_unlock(&buf_lock);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * record - append one call to the trace and release buf_lock, which
+ *     lock_trace took before the call was made
+ */
+static void record(uint32_t op, void *ptr, void *result, size_t size)
+{
+	mmtrace_rec_t *rec;
+
+	if (trace_fd >= 0) {
+		rec = &buf[buf_recs++];
+		rec->time = now_ns() - start_ns;
+		rec->ptr = (uintptr_t)ptr;
+		rec->result = (uintptr_t)result;
+		rec->size = size;
+		rec->tid = my_tid;
+		rec->op = op;
+		if (buf_recs == BUF_RECS)
+			flush_buf();
+	}
+	pthread_mutex_unlock(&buf_lock);
+}
+
+/*
+ * stop_in_child - a forked child must not append to its parent's trace
+ */
+static void stop_in_child(void)
+{
+	trace_fd = -1;
+	buf_recs = 0;
+	my_tid = 0;
+	pthread_mutex_init(&buf_lock, NULL);
+}
+
+/*
+ * start_recording - open the trace file when the library is loaded
+ */
+__attribute__((constructor))
+static void start_recording(void)
+{
+	mmtrace_header_t header = { MMTRACE_MAGIC, MMTRACE_VERSION };
+	const char *file = getenv("MMRECORD_FILE");
+
+	if (file == NULL)
+		file = DEFAULT_FILE;
+	if ((trace_fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return;
+	write_all(&header, sizeof(header));
+	pthread_atfork(NULL, NULL, stop_in_child);
+	start_ns = now_ns();
+}
+
+/*
+ * stop_recording - write out what is left when the program exits
+ */
+__attribute__((destructor))
+static void stop_recording(void)
+{
+	pthread_mutex_lock(&buf_lock);
+	flush_buf();
+	if (trace_fd >= 0)
+		close(trace_fd);
+	trace_fd = -1;
+	pthread_mutex_unlock(&buf_lock);
+}
+
+/*
+ * The interposed allocator functions
+ */
+void *malloc(size_t size)
+{
+	int on = lock_trace();
+	void *p = __libc_malloc(size);
+
+	if (on)
+		record(MMTRACE_MALLOC, NULL, p, size);
+	return p;
+}
+
+void free(void *ptr)
+{
+	uintptr_t addr = (uintptr_t)ptr;
+	int on;
+
+	if (ptr == NULL)
+		return;
+	on = lock_trace();
+	__libc_free(ptr);
+	if (on)
+		record(MMTRACE_FREE, (void *)addr, NULL, 0);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	uintptr_t addr = (uintptr_t)ptr;
+	int on = lock_trace();
+	void *p = __libc_realloc(ptr, size);
+
+	if (on)
+		record(MMTRACE_REALLOC, (void *)addr, p, size);
+	return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	int on = lock_trace();
+	void *p = __libc_calloc(nmemb, size);
+
+	if (on)
+		record(MMTRACE_CALLOC, NULL, p, nmemb * size);
+	return p;
+}
@@ -0,0 +1,37 @@
+/*
+ * mmtrace.h - binary allocation trace format written by mmrecord.so
+ *     and read by mdriver
+ *
+ * A trace is an mmtrace_header_t followed by one mmtrace_rec_t per call,
+ * in the order the calls returned. All fields are in the byte order of
+ * the recording machine.
+ */
+#ifndef __MMTRACE_H_
+#define __MMTRACE_H_
+
+#include <stdint.h>
+
+#define MMTRACE_MAGIC   0x544d4d21u  /* "!MMT" when read as bytes */
+#define MMTRACE_VERSION 1
+
+/* What kind of call a record describes */
+#define MMTRACE_MALLOC  0
+#define MMTRACE_FREE    1
+#define MMTRACE_REALLOC 2
+#define MMTRACE_CALLOC  3
+
+typedef struct {
+	uint32_t magic;         /* MMTRACE_MAGIC */
+	uint32_t version;       /* MMTRACE_VERSION */
+} mmtrace_header_t;
+
+typedef struct {
+	uint64_t time;          /* ns since recording started */
+	uint64_t ptr;           /* block passed in (free, realloc), else 0 */
+	uint64_t result;        /* block returned (malloc, realloc, calloc) */
+	uint64_t size;          /* bytes requested; nmemb * size for calloc */
+	uint32_t tid;           /* kernel thread id of the caller */
+	uint32_t op;            /* MMTRACE_MALLOC, ... */
+} mmtrace_rec_t;
+
+#endif /* __MMTRACE_H_ */
@@ -0,0 +1,261 @@
+/*
+ * mtdriver.c - Multi-threaded throughput driver for the thread-safe mm.c
+ *
+ * Runs the same random malloc/free workload on 1, 2, 4, ... N threads
+ * against one shared mm heap and reports the aggregate throughput at each
+ * thread count, so lock contention and the per-thread caches show up as
+ * speedup (or the lack of it). Build with "make THREADSAFE=1".
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#ifndef THREADSAFE
+#error "mtdriver needs the thread-safe mm.c; build with make THREADSAFE=1"
+#endif
+
+/* Defaults for the command line arguments */
+#define DEFAULT_OPS   1000000 /* malloc/free requests per thread */
+#define DEFAULT_SLOTS 1000    /* live blocks each thread juggles */
+
+/* Per-thread parameters and results */
+typedef struct {
+	int id;                /* thread number, seeds the random stream */
+	int ops;               /* number of requests to issue */
+	int slots;             /* size of the live block table */
+	int use_libc;          /* use libc malloc instead of mm malloc */
+	pthread_barrier_t *start;
+} worker_t;
+
+static void usage(void);
+static void unix_error(const char *msg);
+
+/*
+ * next_rand - xorshift generator, so threads don't share rand()'s state
+ */
+static unsigned int next_rand(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/*
+ * request_size - mostly small objects with a tail of larger buffers:
+ *     80% in [1, 128], 15% in [129, 1024], 5% in [1025, 8192] bytes
+ */
+static size_t request_size(unsigned int *state)
+{
+	unsigned int r = next_rand(state) % 100;
+
+	if (r < 80)
+		return 1 + next_rand(state) % 128;
+	else if (r < 95)
+		return 129 + next_rand(state) % 896;
+	else
+		return 1025 + next_rand(state) % 7168;
+}
+
+/*
+ * run_worker - issue the random request stream of one thread
+ */
+static void *run_worker(void *arg)
+{
+	worker_t *w = arg;
+	unsigned int state = 2463534242u + 7919 * w->id;
+	char **blocks;
+	int i, slot;
+	size_t size;
+
+	if ((blocks = calloc(w->slots, sizeof(char *))) == NULL)
+		unix_error("calloc failed in run_worker");
+
+	pthread_barrier_wait(w->start);
+
+	for (i = 0; i < w->ops; i++) {
+		slot = next_rand(&state) % w->slots;
+		if (blocks[slot] != NULL) {
+			if (w->use_libc)
+				free(blocks[slot]);
+			else
+				mm_free(blocks[slot]);
+			blocks[slot] = NULL;
+		} else {
+			size = request_size(&state);
+			blocks[slot] = w->use_libc ? malloc(size) : mm_malloc(size);
+			if (blocks[slot] == NULL) {
+				fprintf(stderr, "thread %d: malloc of %zu bytes failed\n",
+						w->id, size);
+				exit(1);
+			}
+			/* touch both ends so the block is really used */
+			blocks[slot][0] = (char) i;
+			blocks[slot][size - 1] = (char) i;
+		}
+	}
+
+	for (slot = 0; slot < w->slots; slot++) {
+		if (w->use_libc)
+			free(blocks[slot]);
+		else
+			mm_free(blocks[slot]);
+	}
+	free(blocks);
+	return NULL;
+}
+
+/*
+ * run_threads - time nthreads workers on a fresh heap; returns seconds
+ */
+static double run_threads(int nthreads, int ops, int slots, int use_libc)
+{
+	pthread_t *tids;
+	worker_t *workers;
+	pthread_barrier_t start;
+	struct timespec t0, t1;
+	int i;
+
+	tids = calloc(nthreads, sizeof(pthread_t));
+	workers = calloc(nthreads, sizeof(worker_t));
+	if (tids == NULL || workers == NULL)
+		unix_error("calloc failed in run_threads");
+
+	/* every run starts from an empty heap */
+	if (!use_libc) {
+		mem_reset_brk();
+		if (mm_init() < 0) {
+			fprintf(stderr, "mm_init failed\n");
+			exit(1);
+		}
+	}
+
+	/* the main thread joins the barrier so it can start the clock */
+	pthread_barrier_init(&start, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+		workers[i].id = i;
+		workers[i].ops = ops;
+		workers[i].slots = slots;
+		workers[i].use_libc = use_libc;
+		workers[i].start = &start;
+		if ((errno = pthread_create(&tids[i], NULL, run_worker,
+						&workers[i])) != 0)
+			unix_error("pthread_create failed");
+	}
+
+	pthread_barrier_wait(&start);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	pthread_barrier_destroy(&start);
+	free(workers);
+	free(tids);
+	return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int ops = DEFAULT_OPS;
+	int slots = DEFAULT_SLOTS;
+	int use_libc = 0;
+	int nthreads;
+	double secs, base = 0;
+
+	while ((c = getopt(argc, argv, "t:n:s:lh")) != EOF) {
+		switch (c) {
+			case 't': /* Largest thread count to try */
+				max_threads = atoi(optarg);
+				break;
+
+			case 'n': /* Requests per thread */
+				ops = atoi(optarg);
+				break;
+
+			case 's': /* Live block slots per thread */
+				slots = atoi(optarg);
+				break;
+
+			case 'l': /* Run libc malloc instead */
+				use_libc = 1;
+				break;
+
+			case 'h':
+				usage();
+				exit(0);
+
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (max_threads < 1 || ops < 1 || slots < 1) {
+		usage();
+		exit(1);
+	}
+
+	if (!use_libc)
+		mem_init();
+
+	printf("Results for %s malloc, %d requests per thread:\n",
+			use_libc ? "libc" : "mm", ops);
+	printf("%8s%12s%10s%10s%9s\n", "threads", "ops", "secs", "Kops",
+			"speedup");
+
+	/* 1, 2, 4, ... and finally max_threads itself */
+	for (nthreads = 1; ; nthreads *= 2) {
+		if (nthreads > max_threads)
+			nthreads = max_threads;
+
+		secs = run_threads(nthreads, ops, slots, use_libc);
+		if (nthreads == 1)
+			base = (double) ops / secs;
+		printf("%8d%12.0f%10.4f%10.0f%8.2fx\n", nthreads,
+				(double) nthreads * ops, secs,
+				(double) nthreads * ops / 1e3 / secs,
+				(double) nthreads * ops / secs / base);
+
+		if (nthreads == max_threads)
+			break;
+	}
+
+	if (!use_libc)
+		mem_deinit();
+	return 0;
+}
+
+/*
+ * unix_error - Report the error and its errno.
+ */
+static void unix_error(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+	exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtdriver [-hl] [-t <n>] [-n <ops>] [-s <slots>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-l         Run libc malloc instead of mm malloc.\n");
+	fprintf(stderr, "\t-t <n>     Scale up to n threads (default: online CPUs).\n");
+	fprintf(stderr, "\t-n <ops>   Requests per thread (default %d).\n",
+			DEFAULT_OPS);
+	fprintf(stderr, "\t-s <slots> Live blocks per thread (default %d).\n",
+			DEFAULT_SLOTS);
+}
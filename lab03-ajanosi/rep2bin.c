@@ -0,0 +1,115 @@
+/*
+ * rep2bin.c - convert a .rep text trace into the binary trace format of
+ *     bintrace.h, which mdriver maps into memory instead of parsing:
+ *
+ *     unix> ./rep2bin traces/xterm.rep xterm.bin
+ *     unix> ./mdriver -f xterm.bin
+ *
+ * The text is streamed, so traces of any length can be converted.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bintrace.h"
+
+#define MAXLINE 1024 /* max string size */
+
+static void usage(void);
+static void unix_error(const char *msg, const char *file);
+static void app_error(const char *msg, const char *file);
+
+int main(int argc, char **argv)
+{
+	FILE *in, *out;
+	bintrace_header_t header;
+	bintrace_op_t op;
+	char type[MAXLINE];
+	unsigned int index, size;
+	int max_index = -1;
+	int num_ops = 0;
+
+	if (argc != 3) {
+		usage();
+		exit(1);
+	}
+	if ((in = fopen(argv[1], "r")) == NULL)
+		unix_error("Could not open", argv[1]);
+	if ((out = fopen(argv[2], "wb")) == NULL)
+		unix_error("Could not create", argv[2]);
+
+	/* the four header lines */
+	memset(&header, 0, sizeof(header));
+	header.magic = BINTRACE_MAGIC;
+	header.version = BINTRACE_VERSION;
+	if (fscanf(in, "%d %d %d %d", &header.weight, &header.num_ids,
+				&header.num_ops, &header.ignore_ranges) != 4)
+		app_error("Bad header in", argv[1]);
+	if (fwrite(&header, sizeof(header), 1, out) != 1)
+		unix_error("Could not write", argv[2]);
+
+	/* one record per request line */
+	while (num_ops < header.num_ops && fscanf(in, "%s", type) != EOF) {
+		memset(&op, 0, sizeof(op));
+		switch (type[0]) {
+			case 'a':
+			case 'r':
+				if (fscanf(in, "%u %u", &index, &size) != 2)
+					app_error("Bad request in", argv[1]);
+				op.type = (type[0] == 'a') ? BINTRACE_ALLOC : BINTRACE_REALLOC;
+				op.index = index;
+				op.size = size;
+				break;
+			case 'f':
+				if (fscanf(in, "%u", &index) != 1)
+					app_error("Bad request in", argv[1]);
+				op.type = BINTRACE_FREE;
+				op.index = index;
+				break;
+			default:
+				app_error("Bogus type character in", argv[1]);
+		}
+		if (op.index >= header.num_ids)
+			app_error("Block id out of range in", argv[1]);
+		if (op.index > max_index)
+			max_index = op.index;
+		if (fwrite(&op, sizeof(op), 1, out) != 1)
+			unix_error("Could not write", argv[2]);
+		num_ops++;
+	}
+
+	/* the same checks mdriver makes of a text trace */
+	if (num_ops != header.num_ops || max_index != header.num_ids - 1)
+		app_error("Header does not match the requests in", argv[1]);
+	if (fclose(out) != 0)
+		unix_error("Could not write", argv[2]);
+	fclose(in);
+	return 0;
+}
+
+/*
+ * unix_error - Report the error and its errno, and exit
+ */
+static void unix_error(const char *msg, const char *file)
+{
+	fprintf(stderr, "rep2bin: %s %s: %s\n", msg, file, strerror(errno));
+	exit(1);
+}
+
+/*
+ * app_error - Report the error and exit
+ */
+static void app_error(const char *msg, const char *file)
+{
+	fprintf(stderr, "rep2bin: %s %s\n", msg, file);
+	exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rep2bin <in.rep> <out.bin>\n");
+}
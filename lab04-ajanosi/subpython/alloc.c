@@ -11,20 +11,39 @@
 #include "alloc.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "global.h"
 #include "eval.h"
 
+/*!
+ * After a full collection the pool is doubled until no more than this
+ * fraction of it is in use, so that a working set that outgrows the pool
+ * does not make the collector run over and over.
+ */
+#define POOL_GROW_LOAD 0.5
+
+/*!
+ * After a full collection the pool is halved if less than this fraction of
+ * it is in use, but never below its initial size.
+ */
+#define POOL_SHRINK_LOAD 0.125
+
 /*!
  * Specifies the size of the memory pool.  This is a static local variable;
- * the value is specified in the call to init_alloc().
+ * the value is specified in the call to init_alloc(), and changes as the
+ * pool grows and shrinks.
  */
 static int MEMORY_SIZE;
 
+/*! The size the pool started out with; it is never shrunk below this. */
+static int INITIAL_MEMORY_SIZE;
+
 
 /*!
  * This is the starting address of the memory pool used in the implicit
@@ -41,6 +60,45 @@ static unsigned char *mem;
 static unsigned char *freeptr;
 
 
+/*!
+ * In generational mode, the values allocated since the last collection make
+ * up the "nursery": the part of the pool from this address up to freeptr.
+ * Everything below it has survived a collection and is "old".  Since most
+ * values are temporaries that die young, a minor collection only marks and
+ * compacts the nursery, and the whole pool is collected only when it fills
+ * up.  In the single-generation mode this stays at the start of the pool.
+ */
+static unsigned char *nursery;
+
+/*!
+ * The nursery is collected once it holds this many bytes.  Zero turns the
+ * generational mode off.  The value is specified in the call to mm_init().
+ */
+static int NURSERY_SIZE;
+
+/*!
+ * This is the "remembered set": the slots in old values that the write
+ * barrier has seen a reference to a young value stored into.  Since a minor
+ * collection does not look inside old values, these slots are its roots
+ * along with the globals.  Old values only move in a full collection, which
+ * empties the set, so the slot addresses stay valid until they are used.
+ */
+static Reference **remembered;
+
+/*! This is the number of slots in the remembered set. */
+static int num_remembered;
+
+/*! This is the actual size of the remembered array. */
+static int max_remembered;
+
+/*!
+ * The marker neither marks nor looks inside values below this address.  A
+ * full collection sets it to the start of the pool, and a minor collection
+ * to the start of the nursery.
+ */
+static unsigned char *mark_floor;
+
+
 /*!
  * This is the "reference table."  However, it is really just an array that
  * records where each Value starts in the pool.  References are just indexes
@@ -59,8 +117,68 @@ static int num_refs;
 /*! This is the actual size of the ref_table. */
 static int max_refs;
 
+/*!
+ * This is a stack of the unused slots in the ref_table, so that a new
+ * reference can be handed out without scanning the table for a NULL entry.
+ * The sweeper pushes each slot it frees; make_reference pops them.  It has
+ * room for max_refs entries, so a push can never overflow it.
+ */
+static Reference *free_refs;
+
+/*! This is the number of slots currently on the free_refs stack. */
+static int num_free_refs;
+
 Reference make_reference();
+static void fit_pool(int requested);
+
+
+/*!
+ * The mark stack: references to values that have been marked but whose
+ * contents have not been looked at yet.  Keeping it here rather than on the
+ * C stack lets the marker follow a list or dict of any length.  It is grown
+ * by doubling and kept between collections.
+ */
+static Reference *mark_stack;
+
+/*! This is the number of references on the mark stack. */
+static int mark_top;
 
+/*! This is the actual size of the mark_stack. */
+static int max_mark_stack;
+
+
+/* mark_push
+ * Input: a reference
+ * Output: nothing
+ * This function marks the value the reference refers to, and pushes the
+ * reference on the mark stack so that its contents are marked later. Values
+ * that are already marked, and old values during a minor collection, are
+ * skipped, so each value is pushed at most once.
+ */
+static void mark_push(Reference ref) {
+    Value *curr_val = deref(ref);
+    Reference *new_stack;
+
+    if (!(curr_val) || curr_val->marked == 1 ||
+            (unsigned char *) curr_val < mark_floor) {
+        return;
+    }
+
+    curr_val->marked = 1;
+
+    if (mark_top == max_mark_stack) {
+        max_mark_stack = max_mark_stack == 0 ? INITIAL_SIZE :
+                                               max_mark_stack * 2;
+        new_stack = realloc(mark_stack, sizeof(Reference) * max_mark_stack);
+        if (new_stack == NULL) {
+            error("out of memory");
+            exit(1);
+        }
+        mark_stack = new_stack;
+    }
+
+    mark_stack[mark_top++] = ref;
+}
 
 /* marker
  * Input: a pointer and a reference
@@ -69,52 +187,60 @@ Reference make_reference();
  * looping through and changing the "marked" attribute
  */
 void marker(const char *name, Reference ref) {
-    // dereference to get Value *
-    Value *curr_val = deref(ref);
+    (void) name;
 
-    // base case to check for recursive
-    if (!(curr_val) || curr_val->marked == 1) {
-        return;
-    }
+    mark_push(ref);
 
-    // list node has to mark all values within
-    else if (curr_val->type == VAL_LIST_NODE) {
-        curr_val->marked = 1;
-        ListValue *listval = (ListValue *) curr_val;
-        ListNode listnode = listval->list_node;
+    // mark the contents of everything on the stack until it is empty
+    while (mark_top > 0) {
+        Value *curr_val = deref(mark_stack[--mark_top]);
 
-        // values and next part of list need to be marked
-        marker(name, listnode.value);
-        marker(name, listnode.next);
-    }
+        // list has to mark its array of elements
+        if (curr_val->type == VAL_LIST) {
+            mark_push(((ListValue *) curr_val)->array);
+        }
 
-    // dictionary node has to mark all values within
-    else if (curr_val->type == VAL_DICT_NODE) {
-        curr_val->marked = 1;
-        DictValue *dictval = (DictValue *) curr_val;
-        DictNode dictnode = dictval->dict_node;
+        // array has to mark the elements; its unused slots are NULL_REF
+        else if (curr_val->type == VAL_LIST_ARRAY) {
+            ListArrayValue *array = (ListArrayValue *) curr_val;
+            int i;
 
-        // key, values, and next part of dictionary need to be marked
-        marker(name, dictnode.key);
-        marker(name, dictnode.value);
-        marker(name, dictnode.next);
-    }
+            for (i = 0; i < array->capacity; i++) {
+                mark_push(array->items[i]);
+            }
+        }
+
+        // dictionary has to mark its hash table
+        else if (curr_val->type == VAL_DICT) {
+            mark_push(((DictValue *) curr_val)->table);
+        }
 
-    // these values do not hold smaller values so just mark
-    else {
-        curr_val->marked = 1;
+        // hash table has to mark the keys and values of its entries;
+        // deleted entries have NULL_REF for both
+        else if (curr_val->type == VAL_DICT_TABLE) {
+            DictTableValue *table = (DictTableValue *) curr_val;
+            DictEntry *entries = DICT_ENTRIES(table);
+            int i;
+
+            for (i = 0; i < table->num_entries; i++) {
+                mark_push(entries[i].key);
+                mark_push(entries[i].value);
+            }
+        }
+
+        // the other values do not hold smaller values
     }
 }
 
 /* sweeper_and_compactor
- * Input: Nothing
+ * Input: the address in the heap to start sweeping from
  * Output: Nothing
- * This function goes through the heap and gets rid of the unmarked garbage.
- * It also compacts the memory to the front of the heap.
+ * This function goes through the heap from start and gets rid of the
+ * unmarked garbage. It also compacts the memory towards start.
  */
-void sweeper_and_compactor() {
-    unsigned char *curr = mem;
-    unsigned char *nextfree = mem;
+void sweeper_and_compactor(unsigned char *start) {
+    unsigned char *curr = start;
+    unsigned char *nextfree = start;
 
     // loop through the heap
     while (curr < freeptr) {
@@ -138,8 +264,9 @@ void sweeper_and_compactor() {
         }
         // unmarked so we get rid of it
         else {
-            // set reference table to NULL
+            // set reference table to NULL and remember the slot for reuse
             ref_table[ref] = NULL;
+            free_refs[num_free_refs++] = ref;
         }
         curr += value_size;
     }
@@ -157,13 +284,14 @@ void sweeper_and_compactor() {
  * allocator would request a memory region from the operating system (see the
  * C standard function sbrk(), for example).
  */
-void mm_init(int memory_size) {
+void mm_init(int memory_size, int nursery_size) {
     /*
      * Allocate the entire memory pool, from which our simple allocator will
      * serve allocation requests.
      */
     assert(memory_size > 0);
     MEMORY_SIZE = memory_size;
+    INITIAL_MEMORY_SIZE = memory_size;
     mem = malloc(MEMORY_SIZE);
 
     if (mem == NULL) {
@@ -175,12 +303,26 @@ void mm_init(int memory_size) {
 
     freeptr = mem;
 
+    /* In generational mode, everything allocated from here on is young. */
+    assert(nursery_size >= 0);
+    NURSERY_SIZE = nursery_size;
+    nursery = mem;
+
+    remembered = NULL;
+    num_remembered = 0;
+    max_remembered = 0;
+
+    mark_stack = NULL;
+    mark_top = 0;
+    max_mark_stack = 0;
+
     /* Start out with no references in our reference-table. */
     ref_table = NULL;
     num_refs = 0;
     max_refs = 0;
 
-
+    free_refs = NULL;
+    num_free_refs = 0;
 }
 
 
@@ -210,19 +352,29 @@ Value * mm_malloc(ValueType type, int data_size) {
         data_size = sizeof(IntegerValue) - sizeof(struct Value);
     } else if (type == VAL_FLOAT) {
         data_size = sizeof(FloatValue) - sizeof(struct Value);
-    } else if (type == VAL_LIST_NODE) {
+    } else if (type == VAL_LIST) {
         data_size = sizeof(ListValue) - sizeof(struct Value);
-    } else if (type == VAL_DICT_NODE) {
+    } else if (type == VAL_DICT) {
         data_size = sizeof(DictValue) - sizeof(struct Value);
     }
 
     int requested = sizeof(struct Value) + data_size;
     Value *new_value = NULL;
 
-    // If we don't have space, this might work.
-    if (!has_space_available(requested))
+    // In generational mode, empty the nursery whenever it fills up.  Most
+    // of what is in it will be garbage by then.
+    if (NURSERY_SIZE > 0 && freeptr + requested > nursery + NURSERY_SIZE)
+        collect_nursery();
+
+    // If we don't have space, this might work.  If it doesn't, the pool
+    // has to grow.
+    if (!has_space_available(requested)) {
         collect_garbage();
 
+        if (!has_space_available(requested))
+            fit_pool(requested);
+    }
+
     if (has_space_available(requested)) {
 
         /* Initialize the new Value in the bytes beginning at freeptr. */
@@ -255,12 +407,18 @@ Reference make_reference(Value *value) {
     int i;
     Reference ref;
     Value **new_table;
+    Reference *new_free_refs;
 
     assert(value != NULL);
 
     /* If we don't have a reference table yet, allocate one. */
     if (ref_table == NULL) {
         ref_table = malloc(sizeof(Value *) * INITIAL_SIZE);
+        free_refs = malloc(sizeof(Reference) * INITIAL_SIZE);
+        if (ref_table == NULL || free_refs == NULL) {
+            error("out of memory");
+            exit(1);
+        }
         max_refs = INITIAL_SIZE;
 
         // Set all new reference entries to NULL, just to be safe/clean.
@@ -269,16 +427,15 @@ Reference make_reference(Value *value) {
         }
     }
 
-    /* Scan through the reference table to see if we have any unused slots
-     * that we can use for this value.
+    /* If the garbage collector has freed any slots, reuse the one it freed
+     * most recently.
      */
-    for (i = 0; i < num_refs; i++) {
-        if (ref_table[i] == NULL) {
-            ref = (Reference) i;  // Probably unnecessary, but clearer.
-            ref_table[i] = value;
-            value->ref = ref;
-            return ref;
-        }
+    if (num_free_refs > 0) {
+        ref = free_refs[--num_free_refs];
+        assert(ref_table[ref] == NULL);
+        ref_table[ref] = value;
+        value->ref = ref;
+        return ref;
     }
 
     /* If we got here, we don't have any available slots.  Find out if
@@ -286,7 +443,9 @@ Reference make_reference(Value *value) {
      */
 
     if (num_refs == max_refs) {
-        /* Double the size of the reference table. */
+        /* Double the size of the reference table, and of the free-slot
+         * stack along with it.
+         */
         max_refs *= 2;
         new_table = realloc(ref_table, sizeof(Value *) * max_refs);
         if (new_table == NULL) {
@@ -295,6 +454,13 @@ Reference make_reference(Value *value) {
         }
         ref_table = new_table;
 
+        new_free_refs = realloc(free_refs, sizeof(Reference) * max_refs);
+        if (new_free_refs == NULL) {
+            error("out of memory");
+            exit(1);
+        }
+        free_refs = new_free_refs;
+
         // Set all new reference entries to NULL, just to be safe/clean.
         for (i = num_refs; i < max_refs; i++) {
             ref_table[i] = NULL;
@@ -338,6 +504,129 @@ Value * deref(Reference ref) {
 }
 
 
+/*!
+ * Returns true if a Reference still refers to a Value, i.e. the Value has
+ * not been collected and the Reference has not been handed out again.
+ */
+bool is_live_reference(Reference ref) {
+    return ref >= 0 && ref < num_refs && ref_table[ref] != NULL;
+}
+
+
+/*!
+ * The write barrier.  This must be called whenever a reference is stored
+ * into a Value in the pool, i.e. into a list or dict node, with the address
+ * of the slot being written and the reference being stored.  If an old value
+ * is made to refer to a young one, the slot is added to the remembered set
+ * so that the next minor collection keeps the young value alive.
+ */
+void write_barrier(Reference *slot, Reference value) {
+    unsigned char *addr = (unsigned char *) slot;
+    Reference **new_remembered;
+
+    if (NURSERY_SIZE == 0 || value == NULL_REF)
+        return;
+
+    // Only a young value stored into an old one needs remembering.
+    if (addr < mem || addr >= nursery)
+        return;
+
+    if ((unsigned char *) deref(value) < nursery)
+        return;
+
+    // Loops tend to store into the same slot over and over.
+    if (num_remembered > 0 && remembered[num_remembered - 1] == slot)
+        return;
+
+    if (num_remembered == max_remembered) {
+        max_remembered = max_remembered == 0 ? INITIAL_SIZE :
+                                               max_remembered * 2;
+        new_remembered = realloc(remembered,
+                                 sizeof(Reference *) * max_remembered);
+        if (new_remembered == NULL) {
+            error("out of memory");
+            exit(1);
+        }
+        remembered = new_remembered;
+    }
+
+    remembered[num_remembered++] = slot;
+}
+
+
+/* resize_pool
+ * Input: the new size of the pool in bytes
+ * Output: true if the pool was resized
+ * This function moves the pool into a block of the new size, which must hold
+ * everything in use, and points the reference table at the new addresses of
+ * the values.  It must only be called right after a full collection, when
+ * the remembered set is empty.
+ */
+static bool resize_pool(int new_size) {
+    unsigned char *new_mem;
+    uintptr_t old_base = (uintptr_t) mem;
+    int free_off = (int) ((uintptr_t) freeptr - old_base);
+    int nursery_off = (int) ((uintptr_t) nursery - old_base);
+    int i;
+
+    assert(new_size >= free_off);
+    assert(num_remembered == 0);
+
+    new_mem = realloc(mem, new_size);
+    if (new_mem == NULL) {
+        return false;
+    }
+
+    // realloc may have freed the old pool, so only old_base and the offsets
+    // taken above are used to find where things moved
+    if ((uintptr_t) new_mem != old_base) {
+        // every value keeps its offset in the pool
+        for (i = 0; i < num_refs; i++) {
+            if (ref_table[i] != NULL) {
+                ref_table[i] = (Value *) (new_mem +
+                        ((uintptr_t) ref_table[i] - old_base));
+            }
+        }
+
+        freeptr = new_mem + free_off;
+        nursery = new_mem + nursery_off;
+        mem = new_mem;
+    }
+
+    MEMORY_SIZE = new_size;
+    return true;
+}
+
+/* fit_pool
+ * Input: the size of an allocation that must fit, or 0
+ * Output: nothing
+ * This function is called after a full collection.  It doubles the pool
+ * until the values in use and the requested allocation fill no more than
+ * POOL_GROW_LOAD of it, or halves it if they fill less than POOL_SHRINK_LOAD
+ * and it is bigger than it started out.  If the pool cannot grow, it is left
+ * as it is and mm_malloc() fails as before.
+ */
+static void fit_pool(int requested) {
+    int in_use = (int) (freeptr - mem);
+    int new_size = MEMORY_SIZE;
+
+    while (in_use + requested > new_size * POOL_GROW_LOAD &&
+            new_size <= INT_MAX / 2) {
+        new_size *= 2;
+    }
+
+    if (new_size == MEMORY_SIZE &&
+            in_use + requested < MEMORY_SIZE * POOL_SHRINK_LOAD &&
+            MEMORY_SIZE / 2 >= INITIAL_MEMORY_SIZE) {
+        new_size = MEMORY_SIZE / 2;
+    }
+
+    if (new_size != MEMORY_SIZE && resize_pool(new_size) && !quiet) {
+        fprintf(stderr, "Resized the memory pool to %d bytes.\n", new_size);
+    }
+}
+
+
 /*! Get the amount of in-use memory. */
 int memuse() {
     return freeptr - mem;
@@ -383,20 +672,34 @@ void memdump() {
                     ((StringValue *) curr_value)->string_value);
                 break;
 
-            case VAL_LIST_NODE: {
+            case VAL_LIST: {
                 ListValue *lv = (ListValue *) curr_value;
                 fprintf(stdout,
-                    "type = VAL_LIST_NODE; value_ref = %d; next_ref = %d\n",
-                    lv->list_node.value, lv->list_node.next);
+                    "type = VAL_LIST; length = %d; array_ref = %d\n",
+                    lv->length, lv->array);
+                break;
+            }
+
+            case VAL_LIST_ARRAY: {
+                ListArrayValue *av = (ListArrayValue *) curr_value;
+                fprintf(stdout,
+                    "type = VAL_LIST_ARRAY; capacity = %d\n", av->capacity);
                 break;
             }
 
-            case VAL_DICT_NODE: {
+            case VAL_DICT: {
                 DictValue *dv = (DictValue *) curr_value;
                 fprintf(stdout,
-                    "type = VAL_DICT_NODE; key_ref = %d; value_ref = %d; "
-                    "next_ref = %d\n",
-                    dv->dict_node.key, dv->dict_node.value, dv->dict_node.next);
+                    "type = VAL_DICT; count = %d; table_ref = %d\n",
+                    dv->count, dv->table);
+                break;
+            }
+
+            case VAL_DICT_TABLE: {
+                DictTableValue *tv = (DictTableValue *) curr_value;
+                fprintf(stdout,
+                    "type = VAL_DICT_TABLE; capacity = %d; num_entries = %d\n",
+                    tv->capacity, tv->num_entries);
                 break;
             }
 
@@ -426,11 +729,19 @@ int collect_garbage(void) {
     }
 
     // marking phase
+    mark_floor = mem;
     foreach_global(marker);
 
     // sweeping and compacting phase
-    sweeper_and_compactor();
-    
+    sweeper_and_compactor(mem);
+    sweep_small_ints();
+
+    // everything left has survived, and old values may have moved
+    if (NURSERY_SIZE > 0) {
+        nursery = freeptr;
+        num_remembered = 0;
+    }
+
     reclaimed = (int) (old_freeptr - freeptr);
 
     if (!quiet) {
@@ -439,6 +750,51 @@ int collect_garbage(void) {
         fprintf(stderr, "Reclaimed %d bytes of garbage.\n", reclaimed);
     }
 
+    // resize the pool to what survived
+    fit_pool(0);
+
+    return reclaimed;
+}
+
+/* collect_nursery
+ * Input: nothing
+ * Output: Int of number of bytes reclaimed
+ * This function is the minor collection of the generational mode.  It marks
+ * the young values reachable from the globals and the remembered set, slides
+ * them down to the end of the old values, and promotes them all by moving
+ * the start of the nursery past them.  The old values are not looked at.
+ */
+int collect_nursery(void) {
+    unsigned char *old_freeptr = freeptr;
+    int reclaimed;
+    int i;
+
+    if (!quiet) {
+        fprintf(stderr, "Collecting young garbage.\n");
+    }
+
+    // marking phase, from the globals and the old values that refer to
+    // young ones
+    mark_floor = nursery;
+    foreach_global(marker);
+    for (i = 0; i < num_remembered; i++) {
+        marker("$remembered", *remembered[i]);
+    }
+
+    // sweeping and compacting phase, over the nursery only
+    sweeper_and_compactor(nursery);
+    sweep_small_ints();
+
+    // the survivors are old now, so no old value refers to a young one
+    nursery = freeptr;
+    num_remembered = 0;
+
+    reclaimed = (int) (old_freeptr - freeptr);
+
+    if (!quiet) {
+        fprintf(stderr, "Reclaimed %d bytes of young garbage.\n", reclaimed);
+    }
+
     return reclaimed;
 }
 
@@ -451,5 +807,19 @@ int collect_garbage(void) {
 void mm_cleanup(void) {
     free(mem);
     mem = NULL;
+
+    free(free_refs);
+    free_refs = NULL;
+    num_free_refs = 0;
+
+    free(remembered);
+    remembered = NULL;
+    num_remembered = 0;
+    max_remembered = 0;
+
+    free(mark_stack);
+    mark_stack = NULL;
+    mark_top = 0;
+    max_mark_stack = 0;
 }
 
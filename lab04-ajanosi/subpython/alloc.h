@@ -18,8 +18,9 @@
 /* Returns true if an address is within the pool; false otherwise. */
 bool is_pool_address(void *addr);
 
-/* Initializes allocator state, and memory pool state too. */
-void mm_init(int memory_size);
+/* Initializes allocator state, and memory pool state too.  A nonzero
+ * nursery_size turns on generational collection. */
+void mm_init(int memory_size, int nursery_size);
 
 /* Attempt to allocate a value from the implicit allocator. */
 Value *mm_malloc(ValueType type, int data_size);
@@ -27,6 +28,9 @@ Value *mm_malloc(ValueType type, int data_size);
 /* Dereference a Reference into its corresponding Value. */
 Value *deref(Reference ref);
 
+/* Returns true if a Reference still refers to a Value in the pool. */
+bool is_live_reference(Reference ref);
+
 
 /* Return the amount of used memory. */
 int memuse(void);
@@ -34,9 +38,15 @@ int memuse(void);
 /* Print all allocated objects and free regions in the pool. */
 void memdump(void);
 
+/* Records a store of a reference into a list or dict node in the pool. */
+void write_barrier(Reference *slot, Reference value);
+
 /* Runs the garbage collector to reclaim unused space. */
 int collect_garbage(void);
 
+/* Collects only the values allocated since the last collection. */
+int collect_nursery(void);
+
 /* Clean up the allocator and memory pool state. */
 void mm_cleanup(void);
 
@@ -224,6 +224,7 @@ Node *ast_alloc_identifier(void *pool, const char *name) {
     AST_NODE_DECL(NodeExprIdentifier, EXPR_IDENTIFIER);
     if (node) {
         node->name = ast_pool_strcpy(pool, name);
+        node->slot = -1;
     }
     return (Node *) node;
 }
@@ -127,6 +127,8 @@ typedef struct NodeExprLiteralSingleton {
 typedef struct NodeExprIdentifier {
     NodeType type;
     const char *name;
+    int slot;            /* The global variable slot, or -1 until the
+                          * identifier is first evaluated. */
 } NodeExprIdentifier;
 
 typedef enum NodeExprBuiltinType {
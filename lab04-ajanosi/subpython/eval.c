@@ -12,13 +12,39 @@
 
 #define MAX_DEPTH 4
 
+/*!
+ * Every name that has ever been assigned or looked up gets a slot in this
+ * array, and keeps it for good; a name that is not defined (any more) has a
+ * ref of NULL_REF.  Since slots never move, an identifier in the AST can
+ * remember its slot after the first lookup.
+ */
 struct GlobalVariable {
     char *name;
     Reference ref;
 } *global_vars = NULL;
 
-int num_vars = 0;
-int max_vars = 0;
+int num_slots = 0;
+int max_slots = 0;
+
+/*!
+ * An open-addressing hash table from names to slots in global_vars.  Each
+ * entry is a slot number, or -1 if the entry is empty.  Names are never
+ * removed, so there are no deleted entries.
+ */
+static int *global_index = NULL;
+static int global_index_size = 0;
+
+/*!
+ * Temporary globals are roots that the code cannot refer to, and live in
+ * their own array.  An unused entry holds NULL_REF, and the unused entries
+ * are kept on a stack so that adding one takes constant time.
+ */
+static Reference *temp_globals = NULL;
+static int num_temps = 0;
+static int max_temps = 0;
+
+static int *free_temps = NULL;
+static int num_free_temps = 0;
 
 //////////// EVALUATION ENGINE ////////////
 
@@ -44,6 +70,16 @@ static Reference NONE_REF = NULL_REF;
 static Reference TRUE_REF = NULL_REF;
 static Reference FALSE_REF = NULL_REF;
 
+/* Small integers are interned the first time they are made, so loop
+ * counters and common constants allocate nothing after that.  The cache
+ * does not keep them alive: a collection frees the ones the program no
+ * longer refers to, like any other value, and sweep_small_ints forgets them.
+ * So mem() still only counts what the program holds.  Integers are
+ * immutable, so sharing one value between names is safe. */
+#define SMALL_INT_MIN (-5)
+#define SMALL_INT_MAX 1024
+static Reference small_ints[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+
 
 bool ref_is_none(Reference r) {
     return r == NONE_REF;
@@ -61,9 +97,9 @@ Reference get_bool_ref(bool value) {
 
 //// LOCAL FUNCTION DECLARATIONS ////
 
+int get_global_slot(const char *name);
+static inline int identifier_slot(NodeExprIdentifier *node);
 Reference *add_global_variable(const char *name, Reference value);
-Reference *get_global_variable(const char *name, bool create);
-void delete_global_variable(const char *name);
 
 int add_temporary_global(Reference value);
 void remove_temporary_global(size_t glob);
@@ -82,9 +118,11 @@ Reference make_reference_bool();
 Reference make_reference_int(long int v);
 Reference make_reference_float(double f);
 Reference make_reference_string(const char *value);
-Reference make_reference_string_concat(const char *v1, const char *v2);
-Reference make_reference_list_node(Reference value);
-Reference make_reference_dict_node(Reference key, Reference value);
+Reference make_reference_string_concat(Reference r1, Reference r2);
+Reference make_reference_list();
+Reference make_reference_list_array(int capacity);
+Reference make_reference_dict();
+Reference make_reference_dict_table(int capacity);
 
 
 //// HELPER FUNCTIONS ////
@@ -114,8 +152,8 @@ static const char *get_typestr(Reference r) {
         case VAL_INTEGER:   return "int";
         case VAL_FLOAT:     return "float";
         case VAL_STRING:    return "str";
-        case VAL_LIST_NODE: return "list";
-        case VAL_DICT_NODE: return "dict";
+        case VAL_LIST:      return "list";
+        case VAL_DICT:      return "dict";
         default:            return "<unknown>";
     }
 }
@@ -137,7 +175,7 @@ Promotion get_promotion(Reference l, Reference r) {
 }
 
 ListValue *to_list_value(Value *v) {
-    assert(v == NULL || v->type == VAL_LIST_NODE);
+    assert(v == NULL || v->type == VAL_LIST);
     return (ListValue *) v;
 }
 
@@ -147,7 +185,7 @@ ListValue *deref_to_list_value(Reference ref) {
 
 
 DictValue *to_dict_value(Value *v) {
-    assert(v == NULL || v->type == VAL_DICT_NODE);
+    assert(v == NULL || v->type == VAL_DICT);
     return (DictValue *) v;
 }
 
@@ -157,201 +195,328 @@ DictValue *deref_to_dict_value(Reference ref) {
 }
 
 
+/*! The number of slots in a list's first array. */
+#define LIST_MIN_CAPACITY 4
+
 /*!
- * Returns the length of the list, not including the dummy start value.
+ * Returns the length of the list.
  */
 long int list_get_length(Reference ref) {
-    ListValue *elem = deref_to_list_value(ref);
+    return deref_to_list_value(ref)->length;
+}
+
+/*!
+ * Returns the slot that holds the element of the list at index idx, or
+ * reports an error if the list doesn't have an element at that index.  The
+ * returned pointer is only good until the next allocation.
+ */
+Reference *list_get_slot(Reference ref, long int idx) {
+    ListValue *list = deref_to_list_value(ref);
 
-    /* Skip over the dummy value. */
-    elem = deref_to_list_value(elem->list_node.next);
+    /* If the index is negative, then count from the end of the list. */
+    if (idx < 0) {
+        idx += list->length;
+    }
 
-    long int length = 0;
-    while (elem) {
-        elem = deref_to_list_value(elem->list_node.next);
-        length++;
+    if (idx < 0 || idx >= list->length) {
+        error("list index out of range");
     }
 
-    return length;
+    return &((ListArrayValue *) deref(list->array))->items[idx];
 }
 
 /*!
- * Returns the element of the list at index idx, or reports an error if the
- * list doesn't have an element at that index.
+ * Makes sure the list's array has room for `capacity` elements, replacing
+ * it with a bigger one if it doesn't.  This allocates, so pointers into the
+ * pool are stale afterwards.
  */
-ListValue *list_get_elem(Reference ref, long int idx) {
-    /* If the index is negative, then figure out the length of the list
-     * and compute the true index. */
-    if (idx < 0) {
-        idx += list_get_length(ref);
-    }
+void list_reserve(Reference ref, int capacity) {
+    ListValue *list = deref_to_list_value(ref);
 
-    /* If the index is still negative, then we are out of bounds. */
-    if (idx < 0) {
-        error("list index out of range");
+    if (list->array != NULL_REF &&
+            ((ListArrayValue *) deref(list->array))->capacity >= capacity) {
+        return;
     }
 
-    /* The first node in a list is always a dummy value, so we can ignore it.
-     * (Also, verify that it actually doesn't hold anything.) */
-    ListValue *elem = deref_to_list_value(ref);
-    assert(elem->list_node.value == NULL_REF);
+    Reference array_ref = make_reference_list_array(capacity);
+
+    /* The allocation can move the list and its old array. */
+    list = deref_to_list_value(ref);
+    ListArrayValue *array = (ListArrayValue *) deref(array_ref);
 
-    /* Now traverse (from -1 to skip the dummy element) to the element we
-     * want. */
-    for (int i = -1; elem && i < idx; i++) {
-        ref = elem->list_node.next;
-        elem = deref_to_list_value(ref);
+    if (list->array != NULL_REF) {
+        ListArrayValue *old = (ListArrayValue *) deref(list->array);
+        for (int i = 0; i < list->length; i++) {
+            write_barrier(&array->items[i], old->items[i]);
+            array->items[i] = old->items[i];
+        }
     }
 
-    if (elem == NULL) {
-        error("list index out of range");
+    write_barrier(&list->array, array_ref);
+    list->array = array_ref;
+}
+
+/*!
+ * Adds a value to the end of the list.  If the list's array is full it is
+ * replaced by one twice the size, so that appending takes amortized constant
+ * time.  This can allocate, so the caller must keep the value alive.
+ */
+void list_append(Reference ref, Reference value) {
+    ListValue *list = deref_to_list_value(ref);
+
+    if (list->array == NULL_REF) {
+        list_reserve(ref, LIST_MIN_CAPACITY);
+    } else {
+        int capacity = ((ListArrayValue *) deref(list->array))->capacity;
+        if (list->length == capacity) {
+            list_reserve(ref, capacity * 2);
+        }
     }
 
-    return elem;
+    list = deref_to_list_value(ref);
+    ListArrayValue *array = (ListArrayValue *) deref(list->array);
+
+    write_barrier(&array->items[list->length], value);
+    array->items[list->length++] = value;
 }
 
 void list_delete_elem(Reference ref, long int idx) {
-    /* If the index is negative, then figure out the length of the list
-     * and compute the true index. */
+    ListValue *list = deref_to_list_value(ref);
+
+    /* If the index is negative, then count from the end of the list. */
     if (idx < 0) {
-        idx += list_get_length(ref);
+        idx += list->length;
     }
 
-    /* If the index is still negative, then we are out of bounds. */
-    if (idx < 0) {
+    if (idx < 0 || idx >= list->length) {
         error("list index out of range");
     }
 
-    /* The first node in a list is always a dummy value, so we can ignore it.
-     * (Also, verify that it actually doesn't hold anything.) */
-    ListValue *elem = deref_to_list_value(ref);
-    assert(elem->list_node.value == NULL_REF);
-
-    /* Now traverse (from -1 to skip the dummy element) to the element right
-     * before then one we want. */
-    for (int i = -1; elem && i < idx - 1; i++) {
-        ref = elem->list_node.next;
-        elem = deref_to_list_value(ref);
+    /* Slide the elements after it down over it.  Each element lands in a
+     * new slot, so each store goes through the barrier. */
+    ListArrayValue *array = (ListArrayValue *) deref(list->array);
+    for (long int i = idx; i < list->length - 1; i++) {
+        write_barrier(&array->items[i], array->items[i + 1]);
+        array->items[i] = array->items[i + 1];
     }
 
-    if (elem == NULL) {
-        error("list index out of range");
-    }
+    list->length--;
+    array->items[list->length] = NULL_REF;
+}
 
-    /* Now get the actual element we are trying to delete. */
-    ListValue *next = deref_to_list_value(elem->list_node.next);
 
-    if (next == NULL) {
-        error("list index out of range");
-    }
+/*! The number of index slots in a dictionary's first hash table. */
+#define DICT_MIN_CAPACITY 8
 
-    /* Remove this element from the list. */
-    elem->list_node.next = next->list_node.next;
+static bool is_hashable(ValueType type) {
+    return type != VAL_LIST && type != VAL_DICT;
 }
 
+/*! Scrambles a number into a hash, so that nearby numbers spread out. */
+static unsigned int hash_long(unsigned long int x) {
+    return (unsigned int) ((x * 0x9E3779B97F4A7C15UL) >> 32);
+}
 
 /*!
- * Returns the length of the dict, not including the dummy start value.
+ * Returns the hash of a dictionary key.  Keys that compare equal must hash
+ * the same, so a float with an integral value hashes like the integer.
+ * None, True and False are singletons and hash by their reference.
  */
-long int dict_get_length(Reference ref) {
-    DictValue *elem = deref_to_dict_value(ref);
+static unsigned int hash_ref(Reference ref) {
+    Value *v = deref(ref);
 
-    /* Skip over the dummy value. */
-    elem = deref_to_dict_value(elem->dict_node.next);
+    switch (v->type) {
+        case VAL_INTEGER:
+            return hash_long(((IntegerValue *) v)->integer_value);
 
-    long int length = 0;
-    while (elem) {
-        elem = deref_to_dict_value(elem->dict_node.next);
-        length++;
-    }
+        case VAL_FLOAT: {
+            double f = ((FloatValue *) v)->float_value;
+            unsigned long int bits = 0;
+
+            if (f == floor(f) && fabs(f) < 9e18) {
+                return hash_long((long int) f);
+            }
+            memcpy(&bits, &f, sizeof(f) < sizeof(bits) ? sizeof(f) :
+                                                          sizeof(bits));
+            return hash_long(bits);
+        }
 
-    return length;
+        case VAL_STRING: {
+            /* FNV-1a */
+            unsigned int h = 2166136261u;
+            for (const char *c = ((StringValue *) v)->string_value; *c; c++) {
+                h = (h ^ (unsigned char) *c) * 16777619u;
+            }
+            return h;
+        }
+
+        default:
+            if (!is_hashable(v->type)) {
+                error("unhashable type: '%s'", get_typestr(ref));
+            }
+            return hash_long(ref);
+    }
 }
 
+/*!
+ * Finds a key in a dictionary's hash table.  Returns the index slot that
+ * refers to the key's entry, or -1 if the key is not in the table.  Only
+ * entries with the same hash are compared, so keys of different types are
+ * rarely compared at all.
+ */
+static int dict_find(DictTableValue *table, unsigned int hash,
+                     Reference key) {
+    DictEntry *entries = DICT_ENTRIES(table);
+    int mask = table->capacity - 1;
 
-DictValue *dict_get_entry(Reference ref, Reference key, bool create) {
+    /* The table always has an empty slot, so this terminates. */
+    for (int i = hash & mask; ; i = (i + 1) & mask) {
+        int ix = table->indices[i];
 
-    /* The first node in a dictionary is always a dummy value, so we can
-     * ignore it.  (Also, verify that it actually doesn't hold anything.)
-     */
-    DictValue *start = deref_to_dict_value(ref);
-    DictValue *entry = start;
-    DictValue *prev;
-    assert(start->dict_node.key == NULL_REF);
-    assert(start->dict_node.value == NULL_REF);
-
-    /* Move past the first entry. */
-    entry = deref_to_dict_value(entry->dict_node.next);
-    prev = start;
-
-    /* Iterate until we find our key, or until we reach the end of the
-     * dictionary's entries. */
-    while (entry != NULL) {
-        if (eval_generic_comp(COMP_EQUALS, entry->dict_node.key, key)) {
-            break;
+        if (ix == DICT_EMPTY) {
+            return -1;
+        }
+
+        if (ix >= 0 && entries[ix].hash == hash &&
+                (entries[ix].key == key ||
+                 eval_generic_comp(COMP_EQUALS, entries[ix].key, key))) {
+            return i;
         }
+    }
+}
+
+/*!
+ * Adds an entry for a key that is not in the table yet to the end of the
+ * table's entries, and returns its position.  The table must have room.
+ */
+static int dict_add_entry(DictTableValue *table, unsigned int hash,
+                          Reference key, Reference value) {
+    DictEntry *entries = DICT_ENTRIES(table);
+    int mask = table->capacity - 1;
+    int i, ix;
+
+    assert(table->num_entries < DICT_USABLE(table->capacity));
+
+    /* Take the first slot that doesn't refer to an entry. */
+    for (i = hash & mask; table->indices[i] >= 0; i = (i + 1) & mask)
+        ;
+
+    ix = table->num_entries++;
+    table->indices[i] = ix;
+
+    entries[ix].hash = hash;
+    write_barrier(&entries[ix].key, key);
+    entries[ix].key = key;
+    write_barrier(&entries[ix].value, value);
+    entries[ix].value = value;
+
+    return ix;
+}
 
-        prev = entry;
-        entry = deref_to_dict_value(entry->dict_node.next);
+/*!
+ * Gives the dictionary a new hash table with room for twice its entries,
+ * and moves the entries over, dropping the deleted ones.  This allocates, so
+ * pointers into the pool are stale afterwards.
+ */
+static void dict_resize(Reference ref) {
+    int capacity = DICT_MIN_CAPACITY;
+
+    while (DICT_USABLE(capacity) <= deref_to_dict_value(ref)->count * 2) {
+        capacity *= 2;
     }
 
-    /* If we got NULL, then that means our key is missing. */
-    if (entry == NULL) {
-        if (!create) {
-            /* The caller wants us to report an error. */
-            error("key not found");
+    Reference table_ref = make_reference_dict_table(capacity);
+    DictTableValue *table = (DictTableValue *) deref(table_ref);
+    DictValue *dict = deref_to_dict_value(ref);
+
+    if (dict->table != NULL_REF) {
+        DictTableValue *old = (DictTableValue *) deref(dict->table);
+        DictEntry *entries = DICT_ENTRIES(old);
+
+        for (int ix = 0; ix < old->num_entries; ix++) {
+            if (entries[ix].key != NULL_REF) {
+                dict_add_entry(table, entries[ix].hash,
+                               entries[ix].key, entries[ix].value);
+            }
         }
-        else {
-            /* The caller wants us to create a new entry.  Tack it onto the
-             * end of the dictionary.  Set the key, but we don't know what
-             * value it should have yet.
-             */
-
-            Reference entry_ref = make_reference_dict_node(key, NULL_REF);
-            entry = (DictValue *) deref(entry_ref);
-
-            assert(prev != NULL);
-            assert(prev->dict_node.next == NULL_REF);
-            prev->dict_node.next = entry_ref;
+    }
+
+    write_barrier(&dict->table, table_ref);
+    dict->table = table_ref;
+}
+
+/*!
+ * Returns the length of the dict.
+ */
+long int dict_get_length(Reference ref) {
+    return deref_to_dict_value(ref)->count;
+}
+
+
+/*!
+ * Returns the slot that holds the value for a key in the dictionary.  If the
+ * key is missing, then either an error is reported or, if `create` is true,
+ * a new entry is added with a value of NULL_REF for the caller to fill in.
+ * Adding an entry can allocate, so the caller must keep the key alive; the
+ * returned pointer is only good until the next allocation.
+ */
+Reference *dict_get_slot(Reference ref, Reference key, bool create) {
+    unsigned int hash = hash_ref(key);
+    DictValue *dict = deref_to_dict_value(ref);
+    DictTableValue *table = NULL;
+
+    if (dict->table != NULL_REF) {
+        table = (DictTableValue *) deref(dict->table);
+
+        int i = dict_find(table, hash, key);
+        if (i >= 0) {
+            return &DICT_ENTRIES(table)[table->indices[i]].value;
         }
     }
 
-    return entry;
+    if (!create) {
+        /* The caller wants us to report an error. */
+        error("key not found");
+    }
+
+    /* The caller wants us to create a new entry.  Make room for it first if
+     * the table is full. */
+    if (table == NULL || table->num_entries == DICT_USABLE(table->capacity)) {
+        dict_resize(ref);
+        dict = deref_to_dict_value(ref);
+        table = (DictTableValue *) deref(dict->table);
+    }
+
+    int ix = dict_add_entry(table, hash, key, NULL_REF);
+    dict->count++;
+
+    return &DICT_ENTRIES(table)[ix].value;
 }
 
 void dict_delete_entry(Reference ref, Reference key) {
-    (void) ref;
-    (void) key;
-
-    /* The first node in a dictionary is always a dummy value, so we can
-     * ignore it.  (Also, verify that it actually doesn't hold anything.) */
-    DictValue *prev;
-    DictValue *entry = deref_to_dict_value(ref);
-    assert(entry->dict_node.key == NULL_REF);
-    assert(entry->dict_node.value == NULL_REF);
-
-    /* Move past the first entry. */
-    prev = entry;
-    entry = deref_to_dict_value(entry->dict_node.next);
-
-    /* Iterate until we find our key, or until we reach the end of the
-     * dictionary's entries. */
-    while (entry != NULL) {
-        if (eval_generic_comp(COMP_EQUALS, entry->dict_node.key, key)) {
-            break;
-        }
+    unsigned int hash = hash_ref(key);
+    DictValue *dict = deref_to_dict_value(ref);
+    int i = -1;
 
-        prev = entry;
-        entry = deref_to_dict_value(entry->dict_node.next);
+    if (dict->table != NULL_REF) {
+        i = dict_find((DictTableValue *) deref(dict->table), hash, key);
     }
 
-    /* If we got NULL, then that means our key is missing. */
-    if (entry == NULL) {
+    /* If we got -1, then that means our key is missing. */
+    if (i < 0) {
         error("key not found");
     }
 
-    /* Otherwise, remove the entry. */
-    prev->dict_node.next = entry->dict_node.next;
+    /* Otherwise, remove the entry.  Its slot in the index has to stay
+     * occupied, so that the keys that were probed past it are still found.
+     */
+    DictTableValue *table = (DictTableValue *) deref(dict->table);
+    DictEntry *entry = &DICT_ENTRIES(table)[table->indices[i]];
+
+    table->indices[i] = DICT_DUMMY;
+    entry->key = NULL_REF;
+    entry->value = NULL_REF;
+    dict->count--;
 }
 
 
@@ -371,10 +536,10 @@ static inline bool coerce_ref_to_bool(Reference l) {
             return ((FloatValue *) v)->float_value;
         case VAL_STRING:
             return strlen(((StringValue *) v)->string_value) > 0;
-        case VAL_LIST_NODE:
-            return ((ListValue *) v)->list_node.next != NULL_REF;
-        case VAL_DICT_NODE:
-            return ((DictValue *) v)->dict_node.next != NULL_REF;
+        case VAL_LIST:
+            return ((ListValue *) v)->length > 0;
+        case VAL_DICT:
+            return ((DictValue *) v)->count > 0;
         default:
             error("cannot coerce '%s' to bool", get_typestr(l));
     }
@@ -410,40 +575,44 @@ static inline long int coerce_ref_to_int(Reference l) {
 void ref_print_ext(FILE *os, Reference ref, bool newline, int depth);
 
 void list_print(FILE *os, Reference ref, int depth) {
-    bool first = true;
-
-    /* The first element is a dummy element.  Skip it. */
     ListValue *lv = deref_to_list_value(ref);
-    assert(lv->list_node.value == NULL_REF);
-    lv = deref_to_list_value(lv->list_node.next);
+    if (lv->length == 0) {
+        return;
+    }
 
-    while (lv != NULL) {
-        if (first) {
-            first = false;
-        } else {
+    ListArrayValue *array = (ListArrayValue *) deref(lv->array);
+
+    for (int i = 0; i < lv->length; i++) {
+        if (i > 0) {
             fprintf(os, ", ");
         }
 
         if (depth != 0) {
-            ref_print_ext(os, lv->list_node.value, false, depth - 1);
+            ref_print_ext(os, array->items[i], false, depth - 1);
         } else {
             fprintf(os, "...");
         }
-
-        lv = deref_to_list_value(lv->list_node.next);
     }
 }
 
 void dict_print(FILE *os, Reference ref, int depth) {
     bool first = true;
 
-    /* The first entry is a dummy entry.  Skip it. */
+    /* The entries are in the order they were added.  Skip the deleted
+     * ones. */
     DictValue *dv = deref_to_dict_value(ref);
-    assert(dv->dict_node.key == NULL_REF);
-    assert(dv->dict_node.value == NULL_REF);
-    dv = deref_to_dict_value(dv->dict_node.next);
+    if (dv->table == NULL_REF) {
+        return;
+    }
+
+    DictTableValue *table = (DictTableValue *) deref(dv->table);
+    DictEntry *entries = DICT_ENTRIES(table);
+
+    for (int ix = 0; ix < table->num_entries; ix++) {
+        if (entries[ix].key == NULL_REF) {
+            continue;
+        }
 
-    while (dv != NULL) {
         if (first) {
             first = false;
         } else {
@@ -451,17 +620,15 @@ void dict_print(FILE *os, Reference ref, int depth) {
         }
 
         /* depth irrelevant for keys */
-        ref_print_ext(os, dv->dict_node.key, false, 0);
+        ref_print_ext(os, entries[ix].key, false, 0);
 
         fprintf(os, ": ");
 
         if (depth != 0) {
-            ref_print_ext(os, dv->dict_node.value, false, depth - 1);
+            ref_print_ext(os, entries[ix].value, false, depth - 1);
         } else {
             fprintf(os, "...");
         }
-
-        dv = deref_to_dict_value(dv->dict_node.next);
     }
 }
 
@@ -488,13 +655,13 @@ void ref_print_ext(FILE *os, Reference ref, bool newline, int depth) {
             fprintf(os, "\"%s\"", ((StringValue *) v)->string_value);
             break;
 
-        case VAL_LIST_NODE:
+        case VAL_LIST:
             fprintf(os, "[");
             list_print(os, ref, depth);
             fprintf(os, "]");
             break;
 
-        case VAL_DICT_NODE:
+        case VAL_DICT:
             fprintf(os, "{");
             dict_print(os, ref, depth);
             fprintf(os, "}");
@@ -593,55 +760,63 @@ static bool eval_generic_comp_string(NodeExprBuiltinType type,
 
 static bool eval_generic_comp_list(NodeExprBuiltinType type,
                                    Reference l, Reference r) {
-    if (l == NULL_REF) {
-        switch (type) {
-            case COMP_EQUALS:   return r == NULL_REF;
-            case COMP_LT:       return r != NULL_REF;
-            case COMP_GT:       return false;
-            case COMP_LE:       return true;
-            case COMP_GE:       return r == NULL_REF;
-            default:
-                eval_generic_error(type, l, r);
-        }
-    } else if (r == NULL_REF) {
-        switch (type) {
-            case COMP_EQUALS:   return false;
-            case COMP_LT:       return false;
-            case COMP_GT:       return true;
-            case COMP_LE:       return false;
-            case COMP_GE:       return true;
-            default:
-                eval_generic_error(type, l, r);
-        }
-    }
-
     ListValue *llist = deref_to_list_value(l);
     ListValue *rlist = deref_to_list_value(r);
 
-    Reference lval = llist->list_node.value;
-    Reference rval = rlist->list_node.value;
-    Reference lnext = llist->list_node.next;
-    Reference rnext = rlist->list_node.next;
+    /* Comparing elements doesn't allocate, so these stay valid. */
+    ListArrayValue *larray = llist->length > 0 ?
+        (ListArrayValue *) deref(llist->array) : NULL;
+    ListArrayValue *rarray = rlist->length > 0 ?
+        (ListArrayValue *) deref(rlist->array) : NULL;
+
+    for (int i = 0; ; i++) {
+        bool lend = i >= llist->length;
+        bool rend = i >= rlist->length;
+
+        if (lend) {
+            switch (type) {
+                case COMP_EQUALS:   return rend;
+                case COMP_LT:       return !rend;
+                case COMP_GT:       return false;
+                case COMP_LE:       return true;
+                case COMP_GE:       return rend;
+                default:
+                    eval_generic_error(type, l, r);
+            }
+        } else if (rend) {
+            switch (type) {
+                case COMP_EQUALS:   return false;
+                case COMP_LT:       return false;
+                case COMP_GT:       return true;
+                case COMP_LE:       return false;
+                case COMP_GE:       return true;
+                default:
+                    eval_generic_error(type, l, r);
+            }
+        }
 
-    /* Advance past the dummy element at the start of all lists. */
-    if (lval == NULL_REF || rval == NULL_REF) {
-        return eval_generic_comp_list(type, lnext, rnext);
-    }
+        Reference lval = larray->items[i];
+        Reference rval = rarray->items[i];
 
-    /* Otherwise compare the current element and potentially check the
-     * next in accordance to lexicographical sorting. */
-    switch (type) {
-        case COMP_EQUALS:
-            return eval_generic_comp(type, lval, rval) &&
-                        eval_generic_comp_list(type, lnext, rnext);
-        case COMP_LT:
-        case COMP_GT:
-        case COMP_LE:
-        case COMP_GE:
-            return eval_generic_comp(type, lval, rval) ||
-                        eval_generic_comp_list(type, lnext, rnext);
-        default:
-            eval_generic_error(type, l, r);
+        /* Otherwise compare the current element and potentially check the
+         * next in accordance to lexicographical sorting. */
+        switch (type) {
+            case COMP_EQUALS:
+                if (!eval_generic_comp(type, lval, rval)) {
+                    return false;
+                }
+                break;
+            case COMP_LT:
+            case COMP_GT:
+            case COMP_LE:
+            case COMP_GE:
+                if (eval_generic_comp(type, lval, rval)) {
+                    return true;
+                }
+                break;
+            default:
+                eval_generic_error(type, l, r);
+        }
     }
 }
 
@@ -666,7 +841,7 @@ static bool eval_generic_comp(NodeExprBuiltinType type,
                     case VAL_STRING:
                         return eval_generic_comp_string(type, l, r);
 
-                    case VAL_LIST_NODE:
+                    case VAL_LIST:
                         return eval_generic_comp_list(type, l, r);
 
                     default:
@@ -710,8 +885,12 @@ static Reference eval_generic_comp_nodes(NodeExprBuiltinType type,
  *
  *  This function initializes the standard Python global singletons
  *  None, True and False, which are tied to to respective names and cannot
- *  be deleted. */
+ *  be deleted, and empties the small integer cache. */
 void eval_init() {
+    for (int i = 0; i <= SMALL_INT_MAX - SMALL_INT_MIN; i++) {
+        small_ints[i] = NULL_REF;
+    }
+
     add_global_variable("None",  NONE_REF = make_reference_none());
     add_global_variable("True",  TRUE_REF = make_reference_bool(true));
     add_global_variable("False", FALSE_REF = make_reference_bool(false));
@@ -742,13 +921,22 @@ EvaluationResult eval_main(Node *node) {
                 NodeStmtAssign *assign = (NodeStmtAssign *) node;
 
                 Reference rref = eval_expr(assign->right);
+
+                /* Keep the right hand side alive while the target is
+                 * evaluated, since that can allocate (e.g. a new dict
+                 * entry). */
+                size_t tglob_idx = add_temporary_global(rref);
                 Reference *lref = eval_expr_lval(assign->left, true);
 
                 /* Checking for invalid assignments should have been
                  * done in `eval_expr_lval` which will refuse to evalate
                  * non-lval eligible expressions so we should be fine
-                 * just updating here. */
+                 * just updating here.  The target may be a list or dict
+                 * node, so tell the collector about the store. */
+                write_barrier(lref, rref);
                 *lref = rref;
+
+                remove_temporary_global(tglob_idx);
                 break;
             }
 
@@ -814,9 +1002,17 @@ EvaluationResult eval_del(NodeStmtDel *node) {
         case EXPR_LITERAL_PAIR:
             error("unexpected pair");
 
-        case EXPR_IDENTIFIER:
-            delete_global_variable(((NodeExprIdentifier *) node->arg)->name);
+        case EXPR_IDENTIFIER: {
+            NodeExprIdentifier *ident = (NodeExprIdentifier *) node->arg;
+            int slot = identifier_slot(ident);
+            Reference *ref = &global_vars[slot].ref;
+
+            if (*ref == NULL_REF) {
+                error("Could not delete variable `%s`", ident->name);
+            }
+            *ref = NULL_REF;
             break;
+        }
 
         case EXPR_BUILTIN:
             error("cannot delete result of expression");
@@ -831,11 +1027,11 @@ EvaluationResult eval_del(NodeStmtDel *node) {
             Value *objv = deref(objref);
 
             switch (objv->type) {
-                case VAL_LIST_NODE:
+                case VAL_LIST:
                     list_delete_elem(objref, coerce_ref_to_int(keyref));
                     break;
 
-                case VAL_DICT_NODE:
+                case VAL_DICT:
                     dict_delete_entry(objref, keyref);
                     break;
 
@@ -952,14 +1148,17 @@ static Reference eval_builtin_add(Node *l, Node *r) {
 
             if (lv->type == rv->type) {
                 switch (lv->type) {
-                    case VAL_STRING:
-                        result = make_reference_string_concat(
-                                ((StringValue *) lv)->string_value,
-                                ((StringValue *) rv)->string_value);
+                    case VAL_STRING: {
+                        /* The strings can move when the result is
+                         * allocated, so the right side must stay alive. */
+                        size_t rglob_idx = add_temporary_global(rref);
+                        result = make_reference_string_concat(lref, rref);
+                        remove_temporary_global(rglob_idx);
                         break;
+                    }
 
-                    /* case VAL_LIST_NODE: */
-                    /* case VAL_DICT_NODE: */
+                    /* case VAL_LIST: */
+                    /* case VAL_DICT: */
 
                     default:
                         eval_generic_error(OP_ADD, lref, rref);
@@ -1177,10 +1376,10 @@ static Reference eval_builtin_len(size_t arity, NodeList *args) {
         case VAL_STRING:
             return make_reference_int(v->data_size);
 
-        case VAL_LIST_NODE:
+        case VAL_LIST:
             return make_reference_int(list_get_length(r));
 
-        case VAL_DICT_NODE:
+        case VAL_DICT:
             return make_reference_int(dict_get_length(r));
 
         default:
@@ -1265,13 +1464,12 @@ Reference eval_expr_subscript(NodeExprSubscript *node) {
             break;
         }
 
-        case VAL_LIST_NODE:
-            result = list_get_elem(objref,
-                            coerce_ref_to_int(idxref))->list_node.value;
+        case VAL_LIST:
+            result = *list_get_slot(objref, coerce_ref_to_int(idxref));
             break;
 
-        case VAL_DICT_NODE:
-            result = dict_get_entry(objref, idxref, false)->dict_node.value;
+        case VAL_DICT:
+            result = *dict_get_slot(objref, idxref, false);
             break;
 
         default:
@@ -1282,10 +1480,6 @@ Reference eval_expr_subscript(NodeExprSubscript *node) {
     return result;
 }
 
-static bool is_hashable(ValueType type) {
-    return type != VAL_LIST_NODE && type != VAL_DICT_NODE;
-}
-
 Reference eval_expr(Node *node) {
     switch (node->type) {
         case EXPR_LITERAL_STRING:
@@ -1301,8 +1495,7 @@ Reference eval_expr(Node *node) {
                         ((NodeExprLiteralFloat *) node)->value);
 
         case EXPR_LITERAL_LIST: {
-            /* Lists start with a dummy element so we construct this first. */
-            Reference list = make_reference_list_node(NULL_REF);
+            Reference list = make_reference_list();
 
             /* Add the list to the set of temporary globals so that it
              * does not end up getting garbage collected. */
@@ -1310,19 +1503,24 @@ Reference eval_expr(Node *node) {
 
             NodeList *exprs = ((NodeExprLiteralList *) node)->values;
             if (exprs) {
-                /* Now iterate through the expression list and construct
-                 * the list. */
-                Reference tail = list;
+                /* Size the array for the whole literal up front. */
+                int count = 0;
                 for (NodeListEntry *entry = exprs->head; entry;
                         entry = entry->next) {
+                    count++;
+                }
+                list_reserve(list, count);
 
-                    Reference next = make_reference_list_node(NONE_REF);
-                    deref_to_list_value(tail)->list_node.next = next;
+                /* Now iterate through the expression list and construct
+                 * the list, keeping each element alive while it is
+                 * appended. */
+                for (NodeListEntry *entry = exprs->head; entry;
+                        entry = entry->next) {
 
                     Reference elem = eval_expr(entry->node);
-                    deref_to_list_value(next)->list_node.value = elem;
-
-                    tail = next;
+                    size_t elem_idx = add_temporary_global(elem);
+                    list_append(list, elem);
+                    remove_temporary_global(elem_idx);
                 }
             }
 
@@ -1333,9 +1531,7 @@ Reference eval_expr(Node *node) {
         }
 
         case EXPR_LITERAL_DICT: {
-             /* Similar to list code. Almost identical, but s/List/Dict, and
-              * there are both keys and values... */
-            Reference dict = make_reference_dict_node(NULL_REF, NULL_REF);
+            Reference dict = make_reference_dict();
 
             /* Add the dict to the set of temporary globals so that it
              * does not end up getting garbage collected. */
@@ -1346,7 +1542,6 @@ Reference eval_expr(Node *node) {
                 /* Now iterate through the expression list and construct
                  * the dict. Each element of the list should be a
                  * NodeExprLiteralPair. */
-                Reference tail = dict;
                 for (NodeListEntry *entry = exprs->head; entry;
                         entry = entry->next) {
 
@@ -1357,20 +1552,22 @@ Reference eval_expr(Node *node) {
                     NodeExprLiteralPair *pair =
                         (NodeExprLiteralPair *) entry->node;
 
-                    Reference next = make_reference_dict_node(NONE_REF, NONE_REF);
-                    deref_to_dict_value(tail)->dict_node.next = next;
-
+                    /* Keep the value and the key alive until the entry
+                     * has been added, which can allocate. */
                     Reference valueref = eval_expr(pair->value);
+                    size_t value_idx = add_temporary_global(valueref);
                     Reference keyref = eval_expr(pair->key);
+                    size_t key_idx = add_temporary_global(keyref);
                     if (!is_hashable(deref(keyref)->type)) {
                         error("dictionary keys must be hashable");
                     }
 
-                    DictValue *elem = deref_to_dict_value(next);
-                    elem->dict_node.key = keyref;
-                    elem->dict_node.value = valueref;
+                    Reference *slot = dict_get_slot(dict, keyref, true);
+                    write_barrier(slot, valueref);
+                    *slot = valueref;
 
-                    tail = next;
+                    remove_temporary_global(key_idx);
+                    remove_temporary_global(value_idx);
                 }
             }
 
@@ -1392,9 +1589,16 @@ Reference eval_expr(Node *node) {
         case EXPR_LITERAL_PAIR:
             error("unexpected pair");
 
-        case EXPR_IDENTIFIER:
-            return *get_global_variable(
-                        ((NodeExprIdentifier *) node)->name, false);
+        case EXPR_IDENTIFIER: {
+            NodeExprIdentifier *ident = (NodeExprIdentifier *) node;
+            int slot = identifier_slot(ident);
+            Reference ref = global_vars[slot].ref;
+
+            if (ref == NULL_REF) {
+                error("name '%s' is not defined", ident->name);
+            }
+            return ref;
+        }
 
         case EXPR_BUILTIN:
             return eval_expr_builtin((NodeExprBuiltin *) node);
@@ -1430,9 +1634,16 @@ Reference *eval_expr_lval(Node *node, bool create) {
         case EXPR_LITERAL_PAIR:
             error("unexpected pair");
 
-        case EXPR_IDENTIFIER:
-            return get_global_variable(
-                        ((NodeExprIdentifier *) node)->name, create);
+        case EXPR_IDENTIFIER: {
+            NodeExprIdentifier *ident = (NodeExprIdentifier *) node;
+            int slot = identifier_slot(ident);
+            Reference *ref = &global_vars[slot].ref;
+
+            if (*ref == NULL_REF && !create) {
+                error("name '%s' is not defined", ident->name);
+            }
+            return ref;
+        }
 
         case EXPR_BUILTIN:
             error("cannot assign to result of expression");
@@ -1451,20 +1662,14 @@ Reference *eval_expr_lval(Node *node, bool create) {
             Reference *result;
 
             switch (objv->type) {
-                case VAL_LIST_NODE: {
-                    ListValue *elem = list_get_elem(objref,
-                            coerce_ref_to_int(keyref));
-                    result = &(elem->list_node.value);
+                case VAL_LIST:
+                    result = list_get_slot(objref, coerce_ref_to_int(keyref));
                     break;
-                }
 
-                case VAL_DICT_NODE: {
+                case VAL_DICT:
                     /* Find entry with key or, if applicable, create it. */
-                    DictValue *lhs_dict = dict_get_entry(objref,
-                            keyref, create);
-                    result = &(lhs_dict->dict_node.value);
+                    result = dict_get_slot(objref, keyref, create);
                     break;
-                }
 
                 default:
                     error("'%s' does not support item assignment",
@@ -1484,154 +1689,181 @@ Reference *eval_expr_lval(Node *node, bool create) {
 
 //// GLOBAL VAR FUNCTIONS ////
 
-/*! Adds a new global variable with the provided name. */
-Reference *add_global_variable(const char *name, Reference value) {
-    if (global_vars == NULL) {
-        /* If our global vars array is NULL, let's make a new one. */
-        global_vars = calloc(sizeof(struct GlobalVariable), INITIAL_SIZE);
-        max_vars = INITIAL_SIZE;
-    } else if (num_vars == max_vars) {
-        /* Otherwise, double its size (the JVM internal source said this
-         * was a good resizing semantic, don't sue me!), and zero it out. */
-        max_vars *= 2;
-        global_vars = realloc(global_vars,
-                              sizeof(struct GlobalVariable) * max_vars);
-        // Zero so our loop searching for a new spot doesn't fail.
-        memset(global_vars + num_vars, 0,
-               sizeof(struct GlobalVariable) * num_vars);
+/*! Hashes a variable name (FNV-1a). */
+static unsigned int hash_name(const char *name) {
+    unsigned int h = 2166136261u;
+    for (const char *c = name; *c; c++) {
+        h = (h ^ (unsigned char) *c) * 16777619u;
     }
+    return h;
+}
 
-    if (global_vars == NULL) {
-        error("%s", "Allocation failed!");
-    }
+/*! Adds a slot to the name index, which must have room for it. */
+static void global_index_insert(int slot) {
+    int mask = global_index_size - 1;
+    int i = hash_name(global_vars[slot].name) & mask;
 
-    /* Search for a new variable. */
-    for (int i = 0; i < max_vars; i++) {
-        if (global_vars[i].name == NULL) {
-            num_vars++;
-            global_vars[i].name = strndup(name, strlen(name));
-            global_vars[i].ref = value;
-            return &global_vars[i].ref;
-        }
+    while (global_index[i] >= 0) {
+        i = (i + 1) & mask;
     }
-
-    /* We made space for at least 1 new var up there,
-     * so this can't happen..! I swear! */
-    UNREACHABLE();
+    global_index[i] = slot;
 }
 
-/*! Tries to retrieve a global variable's reference, creating it if `create`
-    is true. */
-Reference *get_global_variable(const char *name, bool create) {
-    for (int i = 0; i < num_vars; i++) {
-        if (global_vars[i].name != NULL &&
-                strcmp(name, global_vars[i].name) == 0) {
-            return &global_vars[i].ref;
+/*!
+ * Returns the slot of the global variable with the provided name, giving the
+ * name a new slot (with no value) if it doesn't have one yet.
+ */
+int get_global_slot(const char *name) {
+    int mask = global_index_size - 1;
+
+    if (global_index != NULL) {
+        for (int i = hash_name(name) & mask; global_index[i] >= 0;
+                i = (i + 1) & mask) {
+            if (strcmp(name, global_vars[global_index[i]].name) == 0) {
+                return global_index[i];
+            }
         }
     }
 
-    if (create) {
-        return add_global_variable(name, NULL_REF);
-    } else {
-        error("name '%s' is not defined", name);
-    }
-}
-
-/*! Delete the global variable with name `name`. Error if no such variable
-    exists. */
-void delete_global_variable(const char *name) {
-    int i;
-    for (i = 0; i < num_vars; i++) {
-        if (strcmp(name, global_vars[i].name) == 0) {
-            break;
+    /* The name is new.  Make room for it in the slots array, doubling its
+     * size (the JVM internal source said this was a good resizing semantic,
+     * don't sue me!). */
+    if (num_slots == max_slots) {
+        max_slots = max_slots == 0 ? INITIAL_SIZE : max_slots * 2;
+        global_vars = realloc(global_vars,
+                              sizeof(struct GlobalVariable) * max_slots);
+        if (global_vars == NULL) {
+            error("%s", "Allocation failed!");
         }
     }
 
-    if (i < num_vars) {
-        // Found the variable.  Remove it by sliding the whole array down.
-        free(global_vars[i].name);
+    int slot = num_slots++;
+    global_vars[slot].name = strndup(name, strlen(name));
+    global_vars[slot].ref = NULL_REF;
 
-        // REVIEW:  Would be faster to do this with a memmove(), but whatever
-        for (int j = i; j < num_vars - 1; j++) {
-            global_vars[j].name = global_vars[j + 1].name;
-            global_vars[j].ref = global_vars[j + 1].ref;
+    /* Keep the index at most half full, so that probes stay short. */
+    if (num_slots * 2 > global_index_size) {
+        free(global_index);
+        global_index_size = global_index_size == 0 ? 2 * INITIAL_SIZE :
+                                                     global_index_size * 2;
+        global_index = malloc(sizeof(int) * global_index_size);
+        if (global_index == NULL) {
+            error("%s", "Allocation failed!");
         }
+        memset(global_index, -1, sizeof(int) * global_index_size);
 
-        num_vars--;
-        global_vars[num_vars].name = NULL;
-        global_vars[num_vars].ref = NULL_REF;
-
-        // TODO: resize array if too small. We'd need to compact it too.
+        for (int i = 0; i < num_slots; i++) {
+            global_index_insert(i);
+        }
     } else {
-        error("Could not delete variable `%s`", name);
+        global_index_insert(slot);
+    }
+
+    return slot;
+}
+
+/*!
+ * Returns the slot of an identifier.  The slot is looked up by name the
+ * first time the identifier is evaluated, and remembered in the AST node, so
+ * that a variable used in a loop costs a single load after that.
+ */
+static inline int identifier_slot(NodeExprIdentifier *node) {
+    if (node->slot < 0) {
+        node->slot = get_global_slot(node->name);
     }
+    return node->slot;
 }
 
-/*! The current index of the next global variable. We assume that this will
- *  not overflow during the execution of this program. */
-static size_t tglob_next = 0;
+/*! Adds a new global variable with the provided name. */
+Reference *add_global_variable(const char *name, Reference value) {
+    int slot = get_global_slot(name);
+    Reference *ref = &global_vars[slot].ref;
+    *ref = value;
+    return ref;
+}
 
 /*!
  * Adds a new temporary global variable that cannot be referred to by the code
- * so that it is a root during execution. These temporary global variables
- * have the naming scheme `$t<id>`.
+ * so that it is a root during execution, and returns its index.
  *
  * All temporary globals are removed by `clear_temporary_globals` which is
  * called by `error` when an error occurs. */
 int add_temporary_global(Reference value) {
-    char buffer[32];
-    snprintf(buffer, 31, "$t%zu", tglob_next);
+    int idx;
 
-    add_global_variable(buffer, value);
-    return tglob_next++;
+    if (num_free_temps > 0) {
+        idx = free_temps[--num_free_temps];
+    } else {
+        if (num_temps == max_temps) {
+            max_temps = max_temps == 0 ? INITIAL_SIZE : max_temps * 2;
+            temp_globals = realloc(temp_globals,
+                                   sizeof(Reference) * max_temps);
+            free_temps = realloc(free_temps, sizeof(int) * max_temps);
+            if (temp_globals == NULL || free_temps == NULL) {
+                error("%s", "Allocation failed!");
+            }
+        }
+        idx = num_temps++;
+    }
+
+    temp_globals[idx] = value;
+    return idx;
 }
 
 /*!
  * Removes the specified temporary global value.
  */
 void remove_temporary_global(size_t glob) {
-    char buffer[32];
-    snprintf(buffer, 31, "$t%zu", glob);
+    assert(glob < (size_t) num_temps);
 
-    delete_global_variable(buffer);
+    temp_globals[glob] = NULL_REF;
+    free_temps[num_free_temps++] = glob;
 }
 
 /*!
- * Removes all temporary global values found in the global variable list.
+ * Removes all temporary global values.
  */
 void clear_temporary_globals() {
-    int new_num_vars = 0;
-    for (int i = 0; i < num_vars; i++) {
-        const char *var_name = global_vars[i].name;
-
-        if (var_name[0] == '$' && var_name[1] == 't') {
-            free(global_vars[i].name);
-        } else {
-            if (i != new_num_vars) {
-                global_vars[new_num_vars].name = global_vars[i].name;
-                global_vars[new_num_vars].ref  = global_vars[i].ref;
-            }
-            new_num_vars++;
-        }
-    }
-
-    memset(&global_vars[new_num_vars], 0,
-            sizeof(struct GlobalVariable) * (num_vars - new_num_vars));
-    num_vars = new_num_vars;
+    num_temps = 0;
+    num_free_temps = 0;
 }
 
 /*!
- * Invokes a function for each global in the global environment.  Returns the
- * number of globals found.
+ * Invokes a function for each global in the global environment, including
+ * the temporary ones.  Returns the number of globals found.
  */
 int foreach_global(void (*f)(const char *name, Reference Ref)) {
+    int found = 0;
 
     /* Call the callback on each global. */
-    for (int i = 0; i < num_vars; i++) {
-        f(global_vars[i].name, global_vars[i].ref);
+    for (int i = 0; i < num_slots; i++) {
+        if (global_vars[i].ref != NULL_REF) {
+            f(global_vars[i].name, global_vars[i].ref);
+            found++;
+        }
+    }
+
+    for (int i = 0; i < num_temps; i++) {
+        if (temp_globals[i] != NULL_REF) {
+            f("$t", temp_globals[i]);
+            found++;
+        }
     }
 
-    return num_vars;
+    return found;
+}
+
+/*!
+ * Forgets the cached small integers that the last collection freed, since
+ * their references may be handed out again.  The collector calls this right
+ * after sweeping.
+ */
+void sweep_small_ints(void) {
+    for (int i = 0; i <= SMALL_INT_MAX - SMALL_INT_MIN; i++) {
+        if (small_ints[i] != NULL_REF && !is_live_reference(small_ints[i])) {
+            small_ints[i] = NULL_REF;
+        }
+    }
 }
 
 void print_global_helper(const char *name, Reference ref) {
@@ -1640,6 +1872,13 @@ void print_global_helper(const char *name, Reference ref) {
 }
 
 void print_globals(void) {
+    int num_vars = 0;
+    for (int i = 0; i < num_slots; i++) {
+        if (global_vars[i].ref != NULL_REF) {
+            num_vars++;
+        }
+    }
+
     // Just so we can make the text reflect the number of globals.
     if (num_vars == 0)
         fprintf(stdout, "0 Globals\n");
@@ -1666,10 +1905,23 @@ Reference make_reference_bool() {
     return v->ref;
 }
 
-/*! Assigns a long int to a new reference in the ref_table. */
+/*! Assigns a long int to a new reference in the ref_table.  Small
+ *  integers share one cached reference per value. */
 Reference make_reference_int(long int i) {
+    Reference *cached = NULL;
+
+    if (i >= SMALL_INT_MIN && i <= SMALL_INT_MAX) {
+        cached = &small_ints[i - SMALL_INT_MIN];
+        if (*cached != NULL_REF) {
+            return *cached;
+        }
+    }
+
     IntegerValue *iv = (IntegerValue *) mm_malloc(VAL_INTEGER, /* ignored */ 0);
     iv->integer_value = i;
+    if (cached != NULL) {
+        *cached = iv->ref;
+    }
     return iv->ref;
 }
 
@@ -1688,29 +1940,59 @@ Reference make_reference_string(const char *value) {
     return sv->ref;
 }
 
-/*! Assigns a concatenated string to a new referecne in the ref_table. */
-Reference make_reference_string_concat(const char *v1, const char *v2) {
-    int len1 = strlen(v1), len2 = strlen(v2);
+/*!
+ * Assigns a concatenated string to a new referecne in the ref_table.  The
+ * strings are passed by reference because allocating the result can move
+ * them; the caller must keep both alive.
+ */
+Reference make_reference_string_concat(Reference r1, Reference r2) {
+    int len1 = strlen(((StringValue *) deref(r1))->string_value);
+    int len2 = strlen(((StringValue *) deref(r2))->string_value);
     StringValue *sv = (StringValue *) mm_malloc(VAL_STRING, len1 + len2 + 1);
-    strcpy(sv->string_value, v1);
-    strcpy(sv->string_value + len1, v2);
+    strcpy(sv->string_value, ((StringValue *) deref(r1))->string_value);
+    strcpy(sv->string_value + len1, ((StringValue *) deref(r2))->string_value);
     return sv->ref;
 }
 
-/*! ListNode allocation helper. */
-Reference make_reference_list_node(Reference value) {
-    ListValue *lv = (ListValue *) mm_malloc(VAL_LIST_NODE, /* ignored */ 0);
-    lv->list_node.value = value;
-    lv->list_node.next = NULL_REF;
+/*! Creates a new, empty list. */
+Reference make_reference_list() {
+    ListValue *lv = (ListValue *) mm_malloc(VAL_LIST, /* ignored */ 0);
+    lv->length = 0;
+    lv->array = NULL_REF;
     return lv->ref;
 }
 
-/*! DictNode allocation helper. */
-Reference make_reference_dict_node(Reference key, Reference value) {
-    DictValue *dv = (DictValue *) mm_malloc(VAL_DICT_NODE, /* ignored */ 0);
-    dv->dict_node.key = key;
-    dv->dict_node.value = value;
-    dv->dict_node.next = NULL_REF;
+/*! Creates an array of `capacity` empty list slots. */
+Reference make_reference_list_array(int capacity) {
+    ListArrayValue *av = (ListArrayValue *) mm_malloc(VAL_LIST_ARRAY,
+            sizeof(ListArrayValue) - sizeof(struct Value) +
+            capacity * sizeof(Reference));
+    av->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        av->items[i] = NULL_REF;
+    }
+    return av->ref;
+}
+
+/*! Creates a new, empty dictionary. */
+Reference make_reference_dict() {
+    DictValue *dv = (DictValue *) mm_malloc(VAL_DICT, /* ignored */ 0);
+    dv->count = 0;
+    dv->table = NULL_REF;
     return dv->ref;
 }
 
+/*! Creates an empty hash table with `capacity` index slots. */
+Reference make_reference_dict_table(int capacity) {
+    DictTableValue *tv = (DictTableValue *) mm_malloc(VAL_DICT_TABLE,
+            sizeof(DictTableValue) - sizeof(struct Value) +
+            capacity * sizeof(int) +
+            DICT_USABLE(capacity) * sizeof(DictEntry));
+    tv->capacity = capacity;
+    tv->num_entries = 0;
+    for (int i = 0; i < capacity; i++) {
+        tv->indices[i] = DICT_EMPTY;
+    }
+    return tv->ref;
+}
+
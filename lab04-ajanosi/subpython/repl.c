@@ -23,6 +23,7 @@
 #define DEFAULT_MEMORY_SIZE 1024
 
 static int memory_size = DEFAULT_MEMORY_SIZE;
+static int nursery_size = 0;
 static int debug = 0;
 
 
@@ -98,7 +99,11 @@ void usage(char *program) {
     printf("usage: %s [OPTION]...\n", program);
     printf("Runs the CS24 Sub-Python interpreter\n\n");
     printf(" -f file        file to run instead of standard input\n");
-    printf(" -m memory_size amount of memory (in bytes) to use for the memory pool\n");
+    printf(" -m memory_size amount of memory (in bytes) to start the memory pool with;\n");
+    printf("                it grows and shrinks with the data in use\n");
+    printf(" -g nursery_size\n");
+    printf("                collect garbage generationally, emptying a nursery of\n");
+    printf("                this many bytes of new values between full collections\n");
     printf(" -q             run in quite mode, supresses extra output\n");
     printf(" -d             run in debug mode:\n");
     printf("                  the REPL will printing out the current bindings and\n");
@@ -116,7 +121,7 @@ int main(int argc, char **argv) {
 
     FILE *input = stdin;
 
-    while ((c = getopt(argc, argv, "f:m:qd")) != -1) {
+    while ((c = getopt(argc, argv, "f:m:g:qd")) != -1) {
         switch (c) {
             case 'f':
                 input = fopen(optarg, "r");
@@ -136,6 +141,15 @@ int main(int argc, char **argv) {
                 }
                 break;
 
+            case 'g':
+                nursery_size = strtol(optarg, NULL, 10);
+                if (nursery_size <= 0) {
+                    fprintf(stderr, "%s: invalid nursery size\n", argv[0]);
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+
             case 'q':
                 quiet = 1;
                 break;
@@ -161,9 +175,12 @@ int main(int argc, char **argv) {
     if (!quiet) {
         printf("Subpython [CS24 SP19]\n");
         printf("Using a memory size of %d bytes.\n", memory_size);
+        if (nursery_size > 0) {
+            printf("Using a nursery size of %d bytes.\n", nursery_size);
+        }
     }
 
-    mm_init(memory_size);
+    mm_init(memory_size, nursery_size);
     eval_init();
     read_eval_print_loop(input);
     mm_cleanup();
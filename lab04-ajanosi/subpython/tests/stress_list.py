@@ -0,0 +1,13 @@
+l = None
+i = 0
+while i < 100000:
+    l = [i, l]
+    i = i + 1
+gc()
+print(l[0], l[1][0], l[1][1][0])
+while i > 1:
+    l = l[1]
+    i = i - 1
+print(l)
+gc()
+mem()
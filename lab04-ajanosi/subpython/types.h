@@ -28,39 +28,24 @@ typedef enum ValueType {
     VAL_INTEGER,        /*!< An integer value. */
     VAL_FLOAT,          /*!< A float value */
     VAL_STRING,         /*!< A string value */
-    VAL_LIST_NODE,      /*!< A node in a list */
-    VAL_DICT_NODE       /*!< A node (key/value pair) in a dictionary */
+    VAL_LIST,           /*!< A list */
+    VAL_LIST_ARRAY,     /*!< The array of elements of a list */
+    VAL_DICT,           /*!< A dictionary */
+    VAL_DICT_TABLE      /*!< The hash table of a dictionary */
 } ValueType;
 
-/*! This is a single element of a linked list. */
-typedef struct ListNode {
-    // if marked or not for garbage collection
-    int marked;
-
-    /*! The value at this index of the list. */
-    Reference value;
-
-    /*! The next node in the list, or NULL_REF if this is the last node. */
-    Reference next;
-
-} ListNode;
-
-
-/*! This is a single entry in a dictionary. */
-typedef struct DictNode {
-    // if marked or not for garbage collection
-    int marked;
+/*! This is a single entry in a dictionary's hash table. */
+typedef struct DictEntry {
+    /*! The hash of the key, so that it need not be recomputed. */
+    unsigned int hash;
 
-    /*! The key for this dictionary entry. */
+    /*! The key for this entry, or NULL_REF if the entry was deleted. */
     Reference key;
 
     /*! The value associated with the key. */
     Reference value;
 
-    /*! The next key/value pair in the dictionary. */
-    Reference next;
-
-} DictNode;
+} DictEntry;
 
 
 /*!
@@ -69,10 +54,11 @@ typedef struct DictNode {
  *
  *  - All numbers are floats
  *  - All strings are '\0' terminated
- *  - Lists are represented as a singly-linked list of ListNode values,
- *    which are themselves allocated from the memory pool
- *  - Dictionaries are represented as a singly-linked list of DictNode
- *    key-value pairs, which are themselves allocated from the memory pool
+ *  - Lists are represented as a ListValue that refers to an array of
+ *    element References, which is itself allocated from the memory pool
+ *  - Dictionaries are represented as a DictValue that refers to a hash
+ *    table of DictEntry key-value pairs, which is itself allocated from the
+ *    memory pool
  */
 typedef struct Value {
     /*!
@@ -214,11 +200,15 @@ typedef struct StringValue {
 
 
 /*!
- * A "list value" type that represents list elements.  It is a subtype
+ * A "list value" type that represents lists.  It is a subtype
  * of Value.  This means that we can cast a ListValue* to a Value* and
  * still access all the Value components.  And, if a Value has a type of
- * VAL_LIST_NODE, we can cast the Value* back to a ListValue* to get at
+ * VAL_LIST, we can cast the Value* back to a ListValue* to get at
  * all the list-related details.
+ *
+ * The elements themselves are kept in a separate ListArrayValue, so that
+ * the array can be replaced by a bigger one without the list's Reference
+ * changing.
  */
 typedef struct ListValue {
     /*!
@@ -239,18 +229,62 @@ typedef struct ListValue {
      */
     int data_size;
 
-    /*! The details of the list element stored in this ListValue. */
-    ListNode list_node;
+    // if marked or not for garbage collection
+    int marked;
+
+    /*! The number of elements in the list. */
+    int length;
+
+    /*! The array of elements, or NULL_REF if the list never had any. */
+    Reference array;
 
 } ListValue;
 
 
 /*!
- * A "dictionary value" type that represents dictionary entries.  It is a
+ * A "list array value" type that holds the elements of a list, in order.
+ * It is a subtype of Value, whose type is VAL_LIST_ARRAY.  The slots past
+ * the list's length hold NULL_REF.
+ */
+typedef struct ListArrayValue {
+    /*!
+     * Every Value knows the Reference associated with it, so that we don't
+     * have to search for what reference goes with a particular value in the
+     * reference table.
+     */
+    Reference ref;
+
+    /*! This specifies what kind of value is actually represented. */
+    ValueType type;
+
+    /*!
+     * This is the size of the data in the value; for an array, the size of
+     * its slots.
+     */
+    int data_size;
+
+    // if marked or not for garbage collection
+    int marked;
+
+    /*! The number of slots in the array. */
+    int capacity;
+
+    /*! The elements of the list. */
+    Reference items[];
+
+} ListArrayValue;
+
+
+/*!
+ * A "dictionary value" type that represents dictionaries.  It is a
  * subtype of Value.  This means that we can cast a DictValue* to a Value*
  * and still access all the Value components.  And, if a Value has a type
- * of VAL_DICT_NODE, we can cast the Value* back to a DictValue* to get at
+ * of VAL_DICT, we can cast the Value* back to a DictValue* to get at
  * all the dictionary-related details.
+ *
+ * The entries themselves are kept in a separate DictTableValue, so that the
+ * table can be replaced by a bigger one without the dictionary's Reference
+ * changing.
  */
 typedef struct DictValue {
     /*!
@@ -271,10 +305,71 @@ typedef struct DictValue {
      */
     int data_size;
 
-    /*! The details of the dictonary entry stored in this DictValue. */
-    DictNode dict_node;
+    // if marked or not for garbage collection
+    int marked;
+
+    /*! The number of entries in the dictionary. */
+    int count;
+
+    /*! The hash table, or NULL_REF if nothing was ever added. */
+    Reference table;
 
 } DictValue;
 
 
+/*!
+ * A "dictionary table value" type that holds the entries of a dictionary.
+ * It is a subtype of Value, whose type is VAL_DICT_TABLE.
+ *
+ * The table is laid out like CPython's: the entries are kept in the order
+ * they were added, after an open-addressing index of `capacity` slots that
+ * each hold DICT_EMPTY, DICT_DUMMY for a deleted entry, or the position of
+ * an entry.  Keeping the entries in order means a dictionary prints its
+ * keys in the order they were added, as it did when it was a linked list.
+ */
+typedef struct DictTableValue {
+    /*!
+     * Every Value knows the Reference associated with it, so that we don't
+     * have to search for what reference goes with a particular value in the
+     * reference table.
+     */
+    Reference ref;
+
+    /*! This specifies what kind of value is actually represented. */
+    ValueType type;
+
+    /*!
+     * This is the size of the data in the value; for a table, the size of
+     * its index and its entries.
+     */
+    int data_size;
+
+    // if marked or not for garbage collection
+    int marked;
+
+    /*! The number of slots in the index; always a power of two. */
+    int capacity;
+
+    /*!
+     * The number of entries added to the table so far, including deleted
+     * ones.  The table is replaced once this reaches DICT_USABLE(capacity).
+     */
+    int num_entries;
+
+    /*! The index; the entries follow it. */
+    int indices[];
+
+} DictTableValue;
+
+/*! Index slot values that do not refer to an entry. */
+#define DICT_EMPTY (-1)
+#define DICT_DUMMY (-2)
+
+/*! The number of entries a table with this many index slots can hold. */
+#define DICT_USABLE(capacity) ((capacity) * 2 / 3)
+
+/*! The entries of a DictTableValue, which follow its index. */
+#define DICT_ENTRIES(table) ((DictEntry *) ((table)->indices + (table)->capacity))
+
+
 #endif /* TYPES_H */
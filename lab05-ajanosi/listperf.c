@@ -7,8 +7,8 @@
 #include <string.h>
 #include <getopt.h>
 
+#include "bench.h"
 #include "lists.h"
-#include "realtime.h"
 
 
 #define DEFAULT_MIN_N 1
@@ -21,8 +21,11 @@
 
 bool verify = false;
 
+/*! How each test is sampled and reported; see ../bench/bench.h. */
+bench_config_t bench_config;
 
-typedef uint64_t (*test_fn_t)(list_t *, int);
+
+typedef void (*test_fn_t)(list_t *, int, bench_t *);
 
 
 /*!
@@ -64,24 +67,23 @@ void sanity_check_list_contents(list_t *list, int n) {
  *
  * The provided list must be empty.
  * The value of n must be positive, but a value of 1 is probably not useful.
+ * The run is measured as one sample of bench.
  */
-uint64_t test_insert_0(list_t *list, int n) {
+void test_insert_0(list_t *list, int n, bench_t *bench) {
     assert(list != NULL);
     assert(list_size(list) == 0);
     assert(n > 0);
 
-    uint64_t start = rdtsc();
+    bench_begin(bench);
 
     // Insert each value at index 0.
     for (int i = n - 1; i >= 0; i--)
         list_insert(list, 0, i);
 
-    uint64_t end = rdtsc();
+    bench_end(bench);
 
     if (verify)
         sanity_check_list_contents(list, n);
-
-    return end - start;
 }
 
 
@@ -90,24 +92,23 @@ uint64_t test_insert_0(list_t *list, int n) {
  *
  * The provided list must be empty.
  * The value of n must be positive, but a value of 1 is probably not useful.
+ * The run is measured as one sample of bench.
  */
-uint64_t test_append(list_t *list, int n) {
+void test_append(list_t *list, int n, bench_t *bench) {
     assert(list != NULL);
     assert(list_size(list) == 0);
     assert(n > 0);
 
-    uint64_t start = rdtsc();
+    bench_begin(bench);
 
     // Append each value to the list.
     for (int i = 0; i < n; i++)
         list_append(list, i);
 
-    uint64_t end = rdtsc();
+    bench_end(bench);
 
     if (verify)
         sanity_check_list_contents(list, n);
-
-    return end - start;
 }
 
 
@@ -117,8 +118,9 @@ uint64_t test_append(list_t *list, int n) {
  *
  * The provided list must be empty, and is loaded with the values 0..n-1.
  * The value of n must be positive, but a value of 1 is probably not useful.
+ * The run is measured as one sample of bench.
  */
-uint64_t test_iter(list_t *list, int n) {
+void test_iter(list_t *list, int n, bench_t *bench) {
     assert(list != NULL);
     assert(list_size(list) == 0);
     assert(n > 0);
@@ -153,7 +155,7 @@ uint64_t test_iter(list_t *list, int n) {
 
     // Access each element of the list in random order.
 
-    uint64_t start = rdtsc();
+    bench_begin(bench);
 
     list_iter_t *iter = list_iter(list);
     for (int i = 0; i < n; i++) {
@@ -167,19 +169,19 @@ uint64_t test_iter(list_t *list, int n) {
     }
     assert(iter == NULL);  // Should have reached the end of the sequence.
 
-    uint64_t end = rdtsc();
-
-    return end - start;
+    bench_end(bench);
 }
 
 
 /*!
  * Runs the specified list performance test on a range of input values from
- * min_n to max_n (inclusive).  If reps > 1 then the test for each n will be
- * run multiple times, and the average will be calculated.
+ * min_n to max_n (inclusive).  The test for each n is run reps times after
+ * the harness's warmup runs, and the average of the runs that are not
+ * outliers is reported.
  */
-void run_perf_test(const char *test_fn_name, test_fn_t test_fn, list_t *list,
-    int min_n, int max_n, int step_n, int reps) {
+void run_perf_test(const char *list_name, const char *test_fn_name,
+    test_fn_t test_fn, list_t *list, int min_n, int max_n, int step_n,
+    int reps) {
 
     assert(min_n > 0);
     assert(max_n >= min_n);
@@ -193,27 +195,51 @@ void run_perf_test(const char *test_fn_name, test_fn_t test_fn, list_t *list,
     fprintf(stderr, "Running \"%s\" test, n = [%d, %d], step = %d, reps = %d\n\n",
         test_fn_name, min_n, max_n, step_n, reps);
 
-    printf("N\tTotal Time\tAverage CPE\n");
+    // Take exactly reps samples of each n.
+    bench_config.kbest = 0;
+    bench_config.minsamples = reps;
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s/%s", list_name, test_fn_name);
+
+    if (bench_config.format == BENCH_TEXT) {
+        printf("N\tTotal Time\tAverage CPE");
+        bench_counter_header(stdout, &bench_config);
+        printf("\n");
+    }
+    else {
+        bench_header(stdout, &bench_config);
+    }
+
     for (int test = 0, n = min_n; n <= max_n; n += step_n) {
         test++;
         if (test % 100 == 0)
             fprintf(stderr, ".");
 
-        // Perform the test a specific number of times, accumulating the total
-        // time.  Then divide this by the number of repetitions to get the
-        // average time taken.
-        uint64_t test_time = 0;
-        for (int iter = 0; iter < reps; iter++) {
+        // Perform the test the requested number of times, clearing the
+        // list before each run.
+        bench_t bench;
+        bench_result_t result;
+        bench_start(&bench, &bench_config);
+        while (bench_more(&bench)) {
             list_clear(list);
-
-            test_time += test_fn(list, n);
+            test_fn(list, n, &bench);
         }
-        test_time /= reps;
+        bench_finish(&bench, &result);
 
-        double clocks_per_elem = (double) test_time / (double) n;
+        if (bench_config.format == BENCH_TEXT) {
+            uint64_t test_time = (uint64_t) result.mean;
+            double clocks_per_elem = (double) test_time / (double) n;
 
-        printf("%d\t%" PRIu64 "\t%.2f\n", n, test_time, clocks_per_elem);
+            printf("%d\t%" PRIu64 "\t%.2f", n, test_time, clocks_per_elem);
+            bench_counter_columns(stdout, &bench_config, n, &result);
+            printf("\n");
+        }
+        else {
+            bench_report(stdout, &bench_config, name, n, &result);
+        }
     }
+    bench_footer(stdout, &bench_config);
     fprintf(stderr, " done\n\n");
 }
 
@@ -260,6 +286,10 @@ void usage(const char *prog) {
            "\tin order to compute an average performance benchmark.  This can help\n"
            "\twhen performance results vary significantly.  Default is %d.\n\n",
            DEFAULT_REPS);
+
+    printf("Benchmark harness options:\n");
+    bench_usage(stdout);
+    printf("\n");
 }
 
 
@@ -277,6 +307,8 @@ int main(int argc, char **argv) {
 
     enum ListType { ARRAY_LIST, LINKED_LIST } list_type = ARRAY_LIST;
 
+    bench_init(&bench_config);
+
     int ch;
     while (true) {
         int option_index = 0;
@@ -292,7 +324,8 @@ int main(int argc, char **argv) {
             {0,        0,                 0,  0 }
         };
 
-        ch = getopt_long(argc, argv, "l:t:m:n:s:r:S:v", longopts, &option_index);
+        ch = getopt_long(argc, argv, "l:t:m:n:s:r:S:v" BENCH_OPTS, longopts,
+                         &option_index);
         if (ch == -1)
             break;
 
@@ -373,6 +406,8 @@ int main(int argc, char **argv) {
             break;
 
         default:
+            if (bench_option(&bench_config, ch, optarg))
+                break;
             printf("?? getopt returned character code 0%o ??\n", ch);
         }
     }
@@ -410,7 +445,8 @@ int main(int argc, char **argv) {
         assert(false); // Should never happen
     }
 
-    run_perf_test(test_fn_name, test_fn, list, min_n, max_n, step_n, reps);
+    run_perf_test(list_type == ARRAY_LIST ? "arraylist" : "linkedlist",
+        test_fn_name, test_fn, list, min_n, max_n, step_n, reps);
     free(test_fn_name);
 
     // Free the list.